@@ -0,0 +1,205 @@
+// Microbenchmark of the vm's dispatch loop and call path.
+//
+// Each benchmark is a loop of straight line bytecode, run until the native
+// `more()` has said yes `N` times, and reports the time per iteration. To
+// compare the two dispatch engines, configure two Release builds with
+// -DJUNE_DEBUG=OFF -DJUNE_BENCH=ON, one of them with -DJUNE_COMPUTED_GOTO=OFF,
+// and run `bin/juneExecBench [N] [runs]` from both.
+
+#include "VM/State.hpp"
+
+#include <chrono>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <map>
+#include <string>
+#include <vector>
+
+using namespace june;
+
+static size_t moreLeft = 0;
+
+static VarBase *more(State &vm, const FnData &fd) {
+  if (moreLeft == 0)
+    return vm.fals;
+  --moreLeft;
+  return vm.tru;
+}
+
+// Builds bytecode with forward jumps to named labels, patched in `finish()`.
+class Asm {
+  Bytecode &bc;
+  size_t idx;
+  std::map<std::string, size_t> labels;
+  std::vector<std::pair<size_t, std::string>> fixups;
+
+public:
+  explicit Asm(Bytecode &bc) : bc(bc), idx(0) {}
+
+  void label(const std::string &name) { labels[name] = idx; }
+  void op(const OpCodes op) { bc.add(idx++, op); }
+  void str(const OpCodes op, const std::string &data) {
+    bc.adds(idx++, op, OdtString, data);
+  }
+  void ident(const OpCodes op, const std::string &name) {
+    bc.adds(idx++, op, OdtIdent, name);
+  }
+  void boolean(const OpCodes op, const bool data) { bc.addb(idx++, op, data); }
+  void size(const OpCodes op, const size_t data) { bc.addsz(idx++, op, data); }
+  void jump(const OpCodes op, const std::string &to) {
+    fixups.push_back({idx, to});
+    bc.addsz(idx++, op, 0);
+  }
+  void call(const size_t &argc) {
+    bc.addsz(idx++, OpCall, arity::encode(argc, false));
+  }
+
+  void finish() {
+    for (auto &f : fixups)
+      bc.updatesz(f.first, labels.at(f.second));
+  }
+
+  // the loop head every benchmark shares
+  void loopHead() {
+    label("top");
+    ident(OpLoad, "more");
+    call(0);
+    jump(OpJumpFalsePop, "end");
+  }
+};
+
+// 256 unconditional jumps, nothing but dispatch
+static void dispatch(Asm &a) {
+  a.loopHead();
+  for (size_t i = 0; i < 256; ++i) {
+    a.jump(OpJump, "j" + std::to_string(i));
+    a.label("j" + std::to_string(i));
+  }
+  a.jump(OpJump, "top");
+  a.label("end");
+}
+
+// 128 loads of a name and a conditional store, either at module level or in
+// the body of a function
+static void loopBody(Asm &a) {
+  a.str(OpLoad, "a");
+  a.str(OpLoad, "x");
+  a.boolean(OpCreate, false);
+  a.boolean(OpLoad, true);
+  a.str(OpLoad, "b");
+  a.boolean(OpCreate, false);
+  a.loopHead();
+  for (size_t i = 0; i < 128; ++i) {
+    a.ident(OpLoad, "x");
+    a.op(OpUnload);
+  }
+  a.ident(OpLoad, "b");
+  a.jump(OpJumpFalsePop, "end");
+  for (bool val : {false, true}) {
+    a.boolean(OpLoad, val);
+    a.ident(OpLoad, "b");
+    a.op(OpStore);
+    a.op(OpUnload);
+  }
+  a.jump(OpJump, "top");
+  a.label("end");
+}
+
+static void loop(Asm &a) { loopBody(a); }
+
+static void fnloop(Asm &a) {
+  a.jump(OpBodyMarker, "fend");
+  a.size(OpBlkA, 1);
+  loopBody(a);
+  a.size(OpBlkR, 1);
+  a.boolean(OpReturn, false);
+  a.label("fend");
+  a.size(OpMakeFunc, arity::encode(0, false));
+  a.str(OpLoad, "f");
+  a.boolean(OpCreate, false);
+  a.ident(OpLoad, "f");
+  a.call(0);
+  a.op(OpUnload);
+}
+
+// 16 calls of a June function taking one argument
+static void call(Asm &a) {
+  a.jump(OpBodyMarker, "fend");
+  a.size(OpBlkA, 1);
+  a.ident(OpLoad, "p");
+  a.str(OpLoad, "q");
+  a.boolean(OpCreate, false);
+  a.ident(OpLoad, "q");
+  a.size(OpBlkR, 1);
+  a.boolean(OpReturn, true);
+  a.label("fend");
+  a.str(OpLoad, "p");
+  a.size(OpMakeFunc, arity::encode(1, false));
+  a.str(OpLoad, "f");
+  a.boolean(OpCreate, false);
+  a.loopHead();
+  for (size_t i = 0; i < 16; ++i) {
+    a.ident(OpLoad, "f");
+    a.str(OpLoad, "arg");
+    a.call(1);
+    a.op(OpUnload);
+  }
+  a.jump(OpJump, "top");
+  a.label("end");
+}
+
+static const struct {
+  const char *name;
+  void (*build)(Asm &);
+} benches[] = {
+    {"dispatch", dispatch},
+    {"loop", loop},
+    {"fnloop", fnloop},
+    {"call", call},
+};
+
+// nanoseconds per iteration of one run, or a negative value on failure
+static double run(void (*build)(Asm &), const size_t &n) {
+  State vm("juneExecBench", ".", {});
+  SrcFile *src = new SrcFile(".", "<bench>", true);
+  Asm a(src->bytecode());
+  build(a);
+  a.finish();
+  src->bytecode().setSrcId(src->id());
+
+  vm.pushSrc(src, 0);
+  vm.globalAdd("more", new VarFunc("", "", {}, {.native = more}, true, 0, 0));
+  moreLeft = n;
+  auto begin = std::chrono::steady_clock::now();
+  auto res = vm::exec(vm);
+  auto end = std::chrono::steady_clock::now();
+  vm.popSrc();
+  if (res.isErr())
+    return -1;
+  return std::chrono::duration<double, std::nano>(end - begin).count() / n;
+}
+
+int main(int argc, char **argv) {
+  size_t n = argc > 1 ? std::strtoull(argv[1], nullptr, 10) : 1000000;
+  size_t runs = argc > 2 ? std::strtoull(argv[2], nullptr, 10) : 5;
+  if (n == 0 || runs == 0) {
+    std::fprintf(stderr, "usage: %s [iterations] [runs]\n", argv[0]);
+    return 1;
+  }
+
+  // best of `runs`, the least disturbed by anything else on the machine
+  for (auto &b : benches) {
+    double best = -1;
+    for (size_t r = 0; r < runs; ++r) {
+      double t = run(b.build, n);
+      if (t < 0) {
+        std::fprintf(stderr, "%s: execution failed\n", b.name);
+        return 1;
+      }
+      best = best < 0 || t < best ? t : best;
+    }
+    std::printf("%-10s %8.1f ns/iter\n", b.name, best);
+  }
+  return 0;
+}
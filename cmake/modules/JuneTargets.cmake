@@ -49,6 +49,9 @@ function(newJuneTarget targetName)
       ${targetName}
       ${NJT_ALL_SOURCES}
       )
+    # static libs are linked into shared modules (Core and native modules) too,
+    # which also needs their thread locals to use a dynamic TLS model
+    set_target_properties(${targetName} PROPERTIES POSITION_INDEPENDENT_CODE ON)
   else()
     # Shared library
     add_library(
@@ -68,12 +71,16 @@ function(newJuneTarget targetName)
   endif()
 
   if (NJT_BINARY)
+    # Core and native modules carry their own copy of the static libs, export
+    # the binary's symbols so they bind to its process wide tables (symbols,
+    # interned strings, heaps) instead of their copies
     set_target_properties(
       ${targetName}
       PROPERTIES
       OUTPUT_NAME ${targetName}
       RUNTIME_OUTPUT_DIRECTORY "${CMAKE_BINARY_DIR}/bin"
       INSTALL_RPATH_USE_LINK_PATH ON
+      ENABLE_EXPORTS ON
     )
 
     install(
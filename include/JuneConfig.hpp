@@ -10,8 +10,14 @@
 /// June version
 #define JuneVersion "0.1"
 
-/// June Memory Debugging
-#define JuneMemDebug true
+/// June VM tracing
+/// Build the tracer (--trace) in, compiled out entirely when false (always
+/// the case for Release builds)
+#define JuneTrace true
+
+/// June VM dispatch
+/// Dispatch instructions through computed goto instead of a switch
+#define JuneComputedGoto true
 
 /// June debug check
 /// The reason it's not a macro is because
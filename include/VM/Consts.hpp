@@ -7,8 +7,14 @@
 
 namespace june {
 namespace constants {
-VarBase *get(State &vm, const OpDataType type, const OpData &opData,
-             const size_t &srcId, const size_t &idx);
+// an undefined value if `type` isn't a constant
+Value get(State &vm, const OpDataType type, const OpData &opData,
+          const size_t &srcId, const size_t &idx);
+
+// Parses every literal loaded by `src` once and moves it into the source's
+// constant pool, rewriting the loads to refer to it by index. Pooled objects
+// are marked const so they're never modified in place.
+void pool(State &vm, SrcFile *src);
 }
 } // namespace june
 
@@ -0,0 +1,68 @@
+#ifndef vm_kernels_hpp
+#define vm_kernels_hpp
+
+#include <cstddef>
+#include <cstdint>
+
+namespace june {
+namespace kernels {
+
+// Bulk operations on the unboxed storage of typed vectors, see `VecData`.
+// They work on several elements at once where the compiler can do so (GCC and
+// Clang vector extensions), so sums over floats may round differently than a
+// plain left to right loop would.
+//
+// Ints are always within `Value::kIntMin` ... `Value::kIntMax`. Where `rhs`
+// is nullptr the operation is done with `scalar` instead, `out` may be `lhs`.
+
+enum MapOp {
+  MapAdd,
+  MapSub,
+  MapMul,
+};
+
+enum CmpOp {
+  CmpLt,
+  CmpLe,
+  CmpGt,
+  CmpGe,
+  CmpEq,
+  CmpNe,
+};
+
+// false if the sum overflows
+bool sum(const long long *vals, const size_t &n, long long &res);
+double sum(const double *vals, const size_t &n);
+// `n` must not be 0
+long long min(const long long *vals, const size_t &n);
+long long max(const long long *vals, const size_t &n);
+double min(const double *vals, const size_t &n);
+double max(const double *vals, const size_t &n);
+// false if the product overflows
+bool dot(const long long *lhs, const long long *rhs, const size_t &n,
+         long long &res);
+double dot(const double *lhs, const double *rhs, const size_t &n);
+
+// false if a product overflows, the sum and difference of two ints in range
+// never do (but may be out of range themselves)
+bool map(const MapOp &op, const long long *lhs, const long long *rhs,
+         const long long &scalar, long long *out, const size_t &n);
+void map(const MapOp &op, const double *lhs, const double *rhs,
+         const double &scalar, double *out, const size_t &n);
+
+// one bit per element, 64 to a word of `out`, which must hold (n + 63) / 64
+// words
+void compare(const CmpOp &op, const long long *lhs, const long long *rhs,
+             const long long &scalar, std::uint64_t *out, const size_t &n);
+void compare(const CmpOp &op, const double *lhs, const double *rhs,
+             const double &scalar, std::uint64_t *out, const size_t &n);
+// set bits among the first `n`
+size_t count(const std::uint64_t *bits, const size_t &n);
+
+// whether every value is within the inline int range
+bool fitInline(const long long *vals, const size_t &n);
+
+} // namespace kernels
+} // namespace june
+
+#endif
@@ -1,10 +1,10 @@
 #ifndef vm_memory_hpp
 #define vm_memory_hpp
 
+#include <atomic>
 #include <cstddef>
-#include <list>
-#include <map>
-#include <vector>
+
+#include "JuneConfig.hpp"
 
 namespace june {
 
@@ -15,24 +15,64 @@ struct __sys_align_t {
   size_t sz;
 };
 
-static constexpr size_t kPoolSize = 4 * 1024;
 static constexpr size_t kAlignment = sizeof(__sys_align_t) - sizeof(size_t);
 
-struct MemoryPool {
-  u8 *head;
-  u8 *mem;
+// allocations up to `kMaxSmallSize` are served from size classes (multiples of
+// 8), anything larger goes straight to the system allocator
+static constexpr size_t kMaxSmallSize = 512;
+static constexpr size_t kSizeClasses = kMaxSmallSize / 8;
+
+// slabs are aligned to their size so the owning slab of any block can be found
+// by masking the block's address
+static constexpr size_t kSlabSize = 64 * 1024;
+
+class MemoryManager;
+
+// intrusive free list node, lives in the first bytes of a free block
+struct MemoryBlock {
+  MemoryBlock *next;
+};
+
+// header at the start of every slab, a slab only holds blocks of one size
+struct MemorySlab {
+  MemoryManager *owner;
+  MemorySlab *next;
+  size_t blockSize;
 };
 
+// A per-thread heap. Blocks freed by the owning thread go back onto its free
+// lists directly, blocks freed by any other thread are pushed onto
+// `remoteFrees` without locking and reclaimed by the owner on its next miss.
 class MemoryManager {
-  std::vector<MemoryPool> pools;
-  std::map<size_t, std::list<u8 *>> free_chunks;
+  MemoryBlock *freeLists[kSizeClasses];
+  MemorySlab *slabs;
+
+  // slab currently being carved for each size class
+  u8 *carveHead[kSizeClasses];
+  u8 *carveEnd[kSizeClasses];
+
+  std::atomic<MemoryBlock *> remoteFrees;
+
+  MemoryManager *nextHeap;
+
+#if JuneTrace == true
+  size_t totalAlloc;
+  size_t totalAllocNoPool;
+  size_t totalAllocRequested;
+  size_t totalManuallyAlloc;
+#endif
+
+  void *allocSlow(const size_t &cls);
+  void allocSlab(const size_t &cls);
+  void reclaimRemote();
 
-  void allocPool();
+  friend class MemoryRegistry;
 
 public:
   MemoryManager();
   ~MemoryManager();
 
+  // the calling thread's heap
   static MemoryManager &instance();
 
   void *alloc(size_t sz);
@@ -2,6 +2,7 @@
 #define vm_opcodes_hpp
 
 #include "Common.hpp"
+#include <cstdint>
 #include <cstdio>
 #include <cstdlib>
 #include <string>
@@ -9,7 +10,9 @@
 
 namespace june {
 
-enum OpCodes {
+class VarBase;
+
+enum OpCodes : unsigned short {
   OpCreate, // Create a new variable
 
   OpStore, // Store a value into a name
@@ -51,12 +54,46 @@ enum OpCodes {
                    // OpPushJump)
   OpPopJump, // unmarks the position to jump to if `or` exists in an expression
 
+  OpNop,        // does nothing, removed by `passes::compact()`
+  OpLoadSlot,   // load a function local from slot `n`
+  OpCreateSlot, // create a function local in slot `n`
+
+  // binary operators: pop the right, then the left operand and push the
+  // result, anything but numbers goes through the type function named after
+  // the operator ("+", "<", ...)
+  OpAdd,
+  OpSub,
+  OpMul,
+  OpDiv,
+  OpMod,
+  OpLt,
+  OpLe,
+  OpGt,
+  OpGe,
+  OpEq,
+  OpNe,
+
+  // compound assignments to the function local in slot `n`, updating inline
+  // numbers in place (see `passes::fuseAssignments()`)
+  OpIncSlot, // `n += 1`, pushes nothing
+  OpDecSlot, // `n -= 1`, pushes nothing
+  OpAddSlot, // `n += <popped value>`, pushes the result like `OpStore`
+  OpSubSlot, // `n -= <popped value>`, pushes the result like `OpStore`
+
+  // superinstructions, the instructions they stand for stay in place right
+  // after them and are skipped (see `passes::fuseSequences()`)
+  OpLoadLoadCall,     // load a name and an argument, then `OpCall`
+  OpLoadJumpFalse,    // load a name, then `OpJumpFalsePop`
+  OpCmpJumpFalse,     // comparison `n` (`OpLt` ... `OpNe`), `OpJumpFalsePop`
+  OpCallUnload,       // `OpCall` whose result is dropped by an `OpUnload`
+  OpMemberCallUnload, // `OpMemberCall` whose result is dropped by an `OpUnload`
+
   _OpLast
 };
 
 extern const char *OpCodeStrs[_OpLast];
 
-enum OpDataType {
+enum OpDataType : unsigned short {
   OdtInt,
   OdtFloat,
   OdtString,
@@ -64,6 +101,9 @@ enum OpDataType {
   OdtSize,
   OdtBool,
   OdtNil,
+  OdtConst,  // index into the source's constant pool, only exists once the
+             // source is loaded in the vm and is never written to a file
+  OdtSymbol, // an interned name (see Symbols.hpp), same lifetime as `OdtConst`
 
   _OdtLast
 };
@@ -77,18 +117,78 @@ union OpData {
 };
 
 struct Op {
-  size_t srcId;
-  size_t idx;
   OpCodes op;
   OpDataType type;
+  // index of the instruction's inline cache + 1, 0 if it has none
+  unsigned int cache;
   OpData data;
 };
 
-std::string opAsString(Op op);
+static_assert(sizeof(Op) == 16, "Op must stay 16 bytes");
+
+// where an instruction comes from, kept out of the instruction stream since
+// it's only needed to report failures
+struct OpLoc {
+  size_t srcId;
+  size_t idx;
+};
+
+std::string opAsString(const Op &op, const OpLoc &loc);
+
+// Operand of `OpCall`, `OpMemberCall` and `OpMakeFunc`, stored as an `OdtSize`:
+// the number of arguments and a flag which, for calls, unpacks the last
+// argument and, for functions, takes variadic arguments.
+namespace arity {
+
+inline size_t encode(const size_t &count, const bool &flag) {
+  return (count << 1) | (flag ? 1 : 0);
+}
+inline size_t count(const size_t &data) { return data >> 1; }
+inline bool flag(const size_t &data) { return data & 1; }
+
+// decodes the string form these operands used to have, a '0' or '1' for the
+// flag followed by one character per argument
+size_t fromString(const char *data);
+
+// whether `op` takes an arity operand
+inline bool takesArity(const OpCodes op) {
+  return op == OpCall || op == OpMemberCall || op == OpMakeFunc;
+}
+
+} // namespace arity
+
+// Inline cache of an `OpMemberCall` or `OpAttr`: the type function found for
+// each receiver type seen there, monomorphic until a second type shows up and
+// given up on past `kEntries` types. Only valid while `epoch` matches the
+// vm's, which changes whenever a type function is added.
+struct TypeFnCache {
+  static constexpr size_t kEntries = 4;
+
+  struct Entry {
+    std::uintptr_t typeFnId;
+    std::uintptr_t type;
+    bool attrBased;
+    VarBase *fn; // borrowed from the vm's type function table
+  };
+
+  Entry entries[kEntries];
+  size_t count = 0;
+  size_t epoch = 0;
+};
 
 struct Bytecode {
 private:
   std::vector<Op> bytecode;
+  // location of each instruction, in step with `bytecode`
+  std::vector<OpLoc> opLocs;
+  // handler address of each instruction, filled by `vm::exec` on first run
+  // when it dispatches through computed goto
+  mutable std::vector<const void *> threadedCode;
+  // like `threadedCode` but every instruction goes to the tracer, used while
+  // tracing instructions
+  mutable std::vector<const void *> tracedCode;
+  // indexed by `Op::cache - 1`, see `passes::assignCaches()`
+  mutable std::vector<TypeFnCache> typeFnCaches;
 
 public:
   ~Bytecode();
@@ -101,11 +201,24 @@ public:
   void addi(const size_t &idx, const OpCodes op, const std::string &data);
   void addf(const size_t &idx, const OpCodes op, const std::string &data);
 
+  void add(const Op &op, const OpLoc &loc);
+
   OpCodes at(const size_t &pos) const;
   void updatesz(const size_t &pos, const size_t &value);
+  void setSrcId(const size_t &srcId);
 
   inline const std::vector<Op> &get() const { return bytecode; }
-  inline std::vector<Op> &getMut() { return bytecode; }
+  inline std::vector<Op> &getMut() {
+    threadedCode.clear();
+    tracedCode.clear();
+    return bytecode;
+  }
+  inline const std::vector<OpLoc> &locs() const { return opLocs; }
+  // must be kept in step with `getMut()` when instructions move
+  inline std::vector<OpLoc> &locsMut() { return opLocs; }
+  inline std::vector<const void *> &threaded() const { return threadedCode; }
+  inline std::vector<const void *> &traced() const { return tracedCode; }
+  inline std::vector<TypeFnCache> &caches() const { return typeFnCaches; }
   inline size_t size() const { return bytecode.size(); }
 };
 
@@ -122,9 +235,15 @@ struct FileCompatibleBytecode {
   std::vector<FileCompatibleOp> bytecode;
 };
 
-using DecompressResult = err::Result<std::vector<Op>, std::string>;
+struct DecompressedBytecode {
+  std::vector<Op> bytecode;
+  std::vector<OpLoc> locs;
+};
+
+using DecompressResult = err::Result<DecompressedBytecode, std::string>;
 
-FileCompatibleBytecode compressBytecode(const std::vector<Op> &bytecode);
+FileCompatibleBytecode compressBytecode(const std::vector<Op> &bytecode,
+                                        const std::vector<OpLoc> &locs);
 DecompressResult decompressBytecode(const FileCompatibleBytecode &bytecode);
 
 struct SrcColRange {
@@ -143,12 +262,14 @@ typedef double f64;
 
 struct ValidRead {
   std::vector<Op> bytecode;
+  std::vector<OpLoc> locs;
   std::vector<SrcColRange> srcRanges;
 };
 
 using ReadResult = err::Result<ValidRead, std::string>;
 
 u8 *writeBytecode(const std::vector<Op> &bytecode,
+                  const std::vector<OpLoc> &locs,
                   const std::vector<SrcColRange> &srcRanges);
 ReadResult readBytecode(const u8 *bytecode);
 
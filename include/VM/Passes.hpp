@@ -0,0 +1,114 @@
+#ifndef vm_passes_hpp
+#define vm_passes_hpp
+
+#include <ostream>
+#include <string>
+#include <vector>
+
+#include "OpCodes.hpp"
+#include "SrcFile.hpp"
+
+namespace june {
+namespace passes {
+
+// the passes `run()` can do without
+enum Pass {
+  PassLocals, // resolveLocals()
+  PassFold,   // foldConstants()
+  PassUnload, // dropUnloaded()
+  PassDead,   // dropDeadCode()
+  PassBlocks, // dropEmptyBlocks()
+  PassJumps,  // threadJumps()
+  PassAssign, // fuseAssignments()
+  PassFuse,   // fuseSequences()
+
+  _PassLast
+};
+
+// the names passes go by on the command line
+extern const char *PassStrs[_PassLast];
+
+// Which passes `run()` does and what came of them, summed up over every
+// source it ran on.
+struct Pipeline {
+  bool enabled[_PassLast];
+  // how many times each pass changed the bytecode
+  size_t changes[_PassLast];
+  // instruction count before and after running the passes
+  size_t before;
+  size_t after;
+
+  Pipeline();
+
+  // turns off the passes in a comma separated list of their names, "all"
+  // turning off every one, false if a name is unknown
+  bool disable(const std::string &list);
+  void dumpStats(std::ostream &os) const;
+};
+
+// Runs the passes below on a freshly loaded source, skipping the ones
+// `pipeline` has turned off. Expects the constant pool to have been built
+// already.
+void run(SrcFile *src, Pipeline &pipeline);
+
+// Gives each variable that is created exactly once in a function body its own
+// slot in the function's activation, turning loads of it into `OpLoadSlot`
+// and its creation into `OpCreateSlot`. Module level variables, names created
+// more than once and anything created dynamically keep their map lookups.
+// Where possible, `self` and the arguments of a function get slots too, see
+// `SrcFile::argsInSlots()`.
+size_t resolveLocals(SrcFile *src);
+
+// Interns the names loaded by `OpLoad`, `OpAttr` and `OpPushJumpNamed`,
+// turning their operands into `OdtSymbol`s.
+void internNames(Bytecode &bc);
+
+// Evaluates operators whose operands are both literal loads, leaving a load
+// of the result. Operators that would fail or need a type function are left
+// alone.
+size_t foldConstants(SrcFile *src);
+
+// Removes literal loads that are unloaded right away.
+size_t dropUnloaded(Bytecode &bc);
+
+// Turns branches on a literal bool into a jump or nothing, then removes
+// whatever nothing jumps to after an unconditional jump, return, `continue`
+// or `break`.
+size_t dropDeadCode(Bytecode &bc);
+
+// Removes `OpBlkA` and `OpBlkR` pairs with nothing in between.
+size_t dropEmptyBlocks(Bytecode &bc);
+
+// Points the `OpJump` family past jumps to unconditional jumps and removes
+// jumps to the instruction right after them.
+size_t threadJumps(Bytecode &bc);
+
+// Turns `x = x + y` and `x = x - y` on a slot-resolved local into
+// `OpAddSlot`/`OpSubSlot`, and into `OpIncSlot`/`OpDecSlot` when `y` is 1 and
+// the result is unused. Must run after `resolveLocals()`.
+size_t fuseAssignments(SrcFile *src);
+
+// Removes the `OpNop`s the passes above leave behind and moves all jump
+// targets along. Returns the new position of every old instruction (and of
+// the end of the bytecode).
+std::vector<size_t> compact(Bytecode &bc);
+
+// Gives every `OpMemberCall`, `OpAttr` and operator its own inline cache.
+void assignCaches(Bytecode &bc);
+
+// Marks a hand-picked set of instruction sequences as superinstructions:
+// loading a function and its argument before `OpCall`, a load or comparison
+// before `OpJumpFalsePop` and calls whose result is unloaded right away.
+// utils/op_profile.py counts sequences in `--trace ops` output to check the
+// set against real programs. The fused instructions stay where they are, so
+// jump targets and source locations don't change. Must run after `compact()`
+// and `assignCaches()`.
+size_t fuseSequences(Bytecode &bc);
+
+// instructions whose operand is a position in the bytecode
+bool isJump(const OpCodes op);
+
+} // namespace passes
+} // namespace june
+
+#endif
@@ -3,10 +3,14 @@
 
 #include <cassert>
 #include <string>
+#include <unordered_map>
+#include <unordered_set>
 #include <vector>
 
 #include "../Common.hpp"
 #include "OpCodes.hpp"
+#include "Symbols.hpp"
+#include "Value.hpp"
 
 namespace june {
 
@@ -18,6 +22,13 @@ class SrcFile {
   std::vector<SrcColRange> _cols;
 
   Bytecode _bytecode;
+  // literals referenced by `OdtConst` operands, see `constants::pool()`
+  std::vector<Value> _consts;
+  // names of the slot-resolved locals of each function, keyed by the
+  // function's body begin, see `passes::resolveLocals()`
+  std::unordered_map<size_t, std::vector<Symbol>> _localNames;
+  // bodies that take `self` in slot 0 and their arguments in the slots after
+  std::unordered_set<size_t> _argSlots;
 
   bool _isMain;
   bool _isBytecode;
@@ -25,12 +36,14 @@ class SrcFile {
 public:
   SrcFile(const std::string &dir, const std::string &path,
           const bool isMain = false);
+  ~SrcFile();
 
   err::Errors loadFile();
 
   void addData(const std::string &data);
   void addCols(const std::vector<SrcColRange> &cols);
-  void addBytecode(const std::vector<june::Op> &bytecode);
+  void addBytecode(const std::vector<june::Op> &bytecode,
+                   const std::vector<june::OpLoc> &locs);
 
   inline size_t id() const { return _id; }
   inline const std::string &dir() const { return _dir; }
@@ -38,6 +51,18 @@ public:
   inline const std::string &data() const { return _data; }
 
   Bytecode &bytecode() { return _bytecode; }
+  inline std::vector<Value> &consts() { return _consts; }
+  inline std::vector<Symbol> &localNames(const size_t &body) {
+    return _localNames[body];
+  }
+  inline std::unordered_map<size_t, std::vector<Symbol>> &
+  allLocalNames() {
+    return _localNames;
+  }
+  inline bool argsInSlots(const size_t &body) const {
+    return _argSlots.find(body) != _argSlots.end();
+  }
+  inline std::unordered_set<size_t> &allArgSlots() { return _argSlots; }
   inline bool isMain() const { return _isMain; }
   inline bool isBytecode() const { return _isBytecode; }
 
@@ -3,22 +3,27 @@
 
 #include <vector>
 
+#include "Value.hpp"
 #include "Vars/Base.hpp"
 
 namespace june {
 
 class Stack {
-  std::vector<VarBase *> _vec;
+  std::vector<Value> _vec;
 
 public:
   Stack();
   ~Stack();
 
-  void push(VarBase *val, const bool iref = true);
-  VarBase *pop(const bool dref = true);
+  void push(const Value &val, const bool iref = true);
+  inline void push(VarBase *val, const bool iref = true) {
+    push(Value::fromVar(val), iref);
+  }
+  // returns an undefined value if the stack is empty
+  Value pop(const bool dref = true);
 
-  inline VarBase *&back() { return _vec.back(); }
-  inline std::vector<VarBase *> &get() { return _vec; }
+  inline Value &back() { return _vec.back(); }
+  inline std::vector<Value> &get() { return _vec; }
   inline size_t size() const { return _vec.size(); }
   inline bool empty() const { return _vec.empty(); }
 };
@@ -9,6 +9,7 @@
 #include "Common.hpp"
 #include "Dylib.hpp"
 #include "FailStack.hpp"
+#include "Passes.hpp"
 #include "SrcFile.hpp"
 #include "Stack.hpp"
 #include "VM/Vars/Base.hpp"
@@ -19,7 +20,8 @@
 namespace june {
 
 typedef std::vector<VarSrc *> SrcStack;
-typedef std::unordered_map<std::string, VarSrc *> AllSrcs;
+// keyed by the interned path of each source
+typedef std::unordered_map<Symbol, VarSrc *> AllSrcs;
 
 #define kExecStackMaxDefault 2000
 
@@ -60,6 +62,9 @@ struct State {
 
   FailStack fails;
 
+  // the passes run on every source as it's loaded
+  passes::Pipeline pipeline;
+
   SrcStack srcStack;
   AllSrcs allSrcs;
   Stack *stack;
@@ -77,7 +82,7 @@ struct State {
   ~State();
 
   void pushSrc(SrcFile *src, const size_t &idx);
-  void pushSrc(const std::string &srcPath);
+  void pushSrc(const Symbol &srcPath);
   void popSrc();
 
   bool juneModuleExists(std::string &mod, const std::string &ext,
@@ -99,8 +104,15 @@ struct State {
   inline VarSrc *currentSource() const { return srcStack.back(); }
   inline SrcFile *currentSourceFile() const { return srcStack.back()->src(); }
 
-  void globalAdd(const std::string &name, VarBase *val, const bool iref = true);
-  VarBase *globalGet(const std::string &name);
+  void globalAdd(const Symbol &name, VarBase *val, const bool iref = true);
+  inline void globalAdd(const std::string &name, VarBase *val,
+                        const bool iref = true) {
+    globalAdd(symbols::intern(name), val, iref);
+  }
+  VarBase *globalGet(const Symbol &name);
+  inline VarBase *globalGet(const std::string &name) {
+    return globalGet(symbols::intern(name));
+  }
 
   template <typename... T>
   void registerType(const std::string &name, const size_t &srcId = 0,
@@ -113,8 +125,12 @@ struct State {
       srcStack.back()->addNativeVar(name, typeVar, true, true);
   }
 
-  void addTypeFn(const std::uintptr_t &type, const std::string &name,
-                 VarBase *fn, const bool iref);
+  void addTypeFn(const std::uintptr_t &type, const Symbol &name, VarBase *fn,
+                 const bool iref);
+  inline void addTypeFn(const std::uintptr_t &type, const std::string &name,
+                        VarBase *fn, const bool iref) {
+    addTypeFn(type, symbols::intern(name), fn, iref);
+  }
   template <typename... T>
   void addNativeTypeFn(const std::string &name, NativeFnPtr fn,
                        const size_t &argsCount, const bool isVarArgs,
@@ -125,11 +141,34 @@ struct State {
                         true, srcId, idx),
               true);
   }
-  VarBase *getTypeFn(VarBase *val, const std::string &name);
+  template <typename... T>
+  void addNativeTypeFn(const std::string &name, NativeFixedFnPtr fn,
+                       const size_t &argsCount, const size_t &srcId,
+                       const size_t &idx) {
+    addTypeFn(type_id<T...>(), name,
+              new VarFunc(srcStack.back()->src()->path(), argsCount, fn, srcId,
+                          idx),
+              true);
+  }
+  VarBase *getTypeFn(const Value &val, const Symbol &name);
+  inline VarBase *getTypeFn(VarBase *val, const Symbol &name) {
+    return getTypeFn(Value::fromVar(val), name);
+  }
+  inline VarBase *getTypeFn(VarBase *val, const std::string &name) {
+    return getTypeFn(Value::fromVar(val), symbols::intern(name));
+  }
+  // same as above, going through (and filling) the inline cache of a call site
+  VarBase *getTypeFn(const Value &val, const Symbol &name, TypeFnCache &cache);
 
   void setTypeName(const std::uintptr_t &type, const std::string &name);
   std::string getTypeName(const std::uintptr_t &type);
   std::string getTypeName(const VarBase *val);
+  std::string getTypeName(const Value &val);
+
+  // A heap object for `val` (borrowed, refcount 0 if freshly made) for the
+  // places that need a `VarBase *`, such as native function arguments.
+  // Undefined values box to nullptr.
+  VarBase *box(const Value &val, const size_t &srcId, const size_t &idx);
 
   inline const std::string &selfBin() const { return _selfBin; }
   inline const std::string &selfBase() const { return _selfBase; }
@@ -145,8 +184,10 @@ private:
   LoadCodeFn srcLoadCodeFn;
   ReadCodeFn srcReadCodeFn;
 
-  std::unordered_map<std::string, VarBase *> _globals;
+  std::unordered_map<Symbol, VarBase *> _globals;
   std::unordered_map<std::uintptr_t, VarsFrame *> _typeFns;
+  // changes with every `addTypeFn()`, invalidating all inline caches
+  size_t _typeFnEpoch;
   std::unordered_map<std::uintptr_t, std::string> _typeNames;
   std::unordered_map<std::string, ModDeInitFn> _modDeInitFns;
   std::string _selfBin;
@@ -164,6 +205,10 @@ using ExecResult = err::Result<size_t, err::Error>;
 ExecResult exec(State &vm, const Bytecode *customBytecode = nullptr,
                 const size_t &begin = 0, const size_t &end = 0);
 
+// evaluates the operator `op` (`OpAdd` ... `OpNe`) on two constants the way
+// `exec()` would, false if that needs a type function or fails
+bool fold(const OpCodes &op, const Value &lhs, const Value &rhs, Value &res);
+
 } // namespace vm
 
 } // namespace june
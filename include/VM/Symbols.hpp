@@ -0,0 +1,26 @@
+#ifndef vm_symbols_hpp
+#define vm_symbols_hpp
+
+#include <string>
+
+namespace june {
+
+// An interned name. Every name is interned once, process wide, so equal names
+// always map to the same symbol and tables keyed by names can key on (and
+// compare) small integers instead of hashing strings.
+typedef unsigned int Symbol;
+
+namespace symbols {
+
+// the empty name, used where there's no name
+static constexpr Symbol kNone = 0;
+
+Symbol intern(const std::string &name);
+Symbol intern(const char *name);
+// the name `sym` was interned from, stays valid for as long as the process
+const std::string &name(const Symbol &sym);
+
+} // namespace symbols
+} // namespace june
+
+#endif
@@ -0,0 +1,52 @@
+#ifndef vm_trace_hpp
+#define vm_trace_hpp
+
+#include <string>
+
+#include "JuneConfig.hpp"
+
+namespace june {
+namespace trace {
+
+// what can be traced, one bit each
+enum Kind : unsigned {
+  TraceOps = 1 << 0, // every instruction the vm executes
+  TraceMem = 1 << 1, // every allocation and free of the memory manager
+};
+
+#if JuneTrace == true
+extern unsigned kinds;
+
+inline bool enabled(const Kind &kind) { return (kinds & kind) != 0; }
+
+// Turns on tracing of a comma separated list of kinds ("ops", "mem" or "all"),
+// records go to `path` or to stderr if it's empty. False if a kind is unknown
+// or the file can't be opened.
+bool enable(const std::string &list, const std::string &path);
+
+// Appends one record, a line of tab separated fields that starts with the name
+// of `kind`. Records are buffered and only written out once the buffer fills
+// up, on `flush()` and at exit.
+void record(const Kind &kind, const char *fmt, ...)
+    __attribute__((format(printf, 2, 3)));
+void flush();
+#endif
+
+} // namespace trace
+} // namespace june
+
+// Traces a record of `kind` if it's enabled. Compiles to nothing (arguments
+// included) when the tracer isn't built in.
+#if JuneTrace == true
+#define traceRecord(kind, ...)                                                 \
+  do {                                                                         \
+    if (june::trace::enabled(kind))                                            \
+      june::trace::record(kind, __VA_ARGS__);                                  \
+  } while (0)
+#else
+#define traceRecord(kind, ...)                                                 \
+  do {                                                                         \
+  } while (0)
+#endif
+
+#endif
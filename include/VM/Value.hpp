@@ -0,0 +1,122 @@
+#ifndef vm_value_hpp
+#define vm_value_hpp
+
+#include <cstdint>
+#include <cstring>
+#include <string>
+
+namespace june {
+
+class VarBase;
+struct State;
+
+/// A value as seen by the VM (on the stack, in scopes, as call arguments).
+///
+/// `int`, `float`, `bool` and `nil` live inline and are never allocated or
+/// refcounted; every other value is a `VarBase *`. Values are NaN-boxed:
+///
+///     any other bit pattern   float (NaNs are canonicalized)
+///     0x7FFC'0000'0000'000t   undefined (t=0), nil (1), false (2), true (3)
+///     0x7FFD'iiii'iiii'iiii   int, 48 bit two's complement payload
+///     0xFFFC'pppp'pppp'pppp   VarBase *, 48 bit pointer
+///
+/// Ints that don't fit into 48 bits are kept on the heap as a `VarInt`.
+class Value {
+  std::uint64_t _bits;
+
+  static constexpr std::uint64_t kQNaN = 0x7FFC000000000000ULL;
+  static constexpr std::uint64_t kTagMask = 0xFFFF000000000000ULL;
+  static constexpr std::uint64_t kPayloadMask = 0x0000FFFFFFFFFFFFULL;
+
+  static constexpr std::uint64_t kTagSpecial = 0x7FFC000000000000ULL;
+  static constexpr std::uint64_t kTagInt = 0x7FFD000000000000ULL;
+  static constexpr std::uint64_t kTagVar = 0xFFFC000000000000ULL;
+
+  static constexpr std::uint64_t kUndef = kTagSpecial | 0;
+  static constexpr std::uint64_t kNil = kTagSpecial | 1;
+  static constexpr std::uint64_t kFalse = kTagSpecial | 2;
+  static constexpr std::uint64_t kTrue = kTagSpecial | 3;
+
+  static constexpr std::uint64_t kCanonicalNaN = 0x7FF8000000000000ULL;
+
+  explicit constexpr Value(std::uint64_t bits) : _bits(bits) {}
+
+public:
+  static constexpr long long kIntMin = -(1LL << 47);
+  static constexpr long long kIntMax = (1LL << 47) - 1;
+
+  /// An undefined value, used where a `VarBase *` would have been `nullptr`.
+  constexpr Value() : _bits(kUndef) {}
+
+  static inline Value nil() { return Value(kNil); }
+  static inline Value fromBool(const bool &val) {
+    return Value(val ? kTrue : kFalse);
+  }
+  static inline Value fromFloat(const double &val) {
+    if (val != val)
+      return Value(kCanonicalNaN);
+    std::uint64_t bits;
+    std::memcpy(&bits, &val, sizeof(bits));
+    return Value(bits);
+  }
+  static inline Value fromVar(VarBase *var) {
+    if (var == nullptr)
+      return Value();
+    return Value(kTagVar | (reinterpret_cast<std::uintptr_t>(var) &
+                            kPayloadMask));
+  }
+  static inline bool fitsInt(const long long &val) {
+    return val >= kIntMin && val <= kIntMax;
+  }
+  // allocates a `VarInt` if `val` doesn't fit inline (defined in Vars/Base.hpp)
+  static inline Value fromInt(const long long &val);
+
+  inline bool isUndef() const { return _bits == kUndef; }
+  inline bool isNil() const { return _bits == kNil; }
+  inline bool isBool() const { return (_bits | 1) == kTrue; }
+  inline bool isInt() const { return (_bits & kTagMask) == kTagInt; }
+  inline bool isFloat() const { return (_bits & kQNaN) != kQNaN; }
+  inline bool isVar() const { return (_bits & kTagMask) == kTagVar; }
+  // `int`, `float`, `bool` or `nil` stored inline
+  inline bool isImmediate() const { return !isVar() && !isUndef(); }
+
+  inline bool asBool() const { return _bits == kTrue; }
+  inline long long asInt() const {
+    return static_cast<long long>(_bits << 16) >> 16;
+  }
+  inline double asFloat() const {
+    double val;
+    std::memcpy(&val, &_bits, sizeof(val));
+    return val;
+  }
+  inline VarBase *asVar() const {
+    return reinterpret_cast<VarBase *>(_bits & kPayloadMask);
+  }
+
+  inline std::uint64_t bits() const { return _bits; }
+  inline bool operator==(const Value &other) const {
+    return _bits == other._bits;
+  }
+  inline bool operator!=(const Value &other) const {
+    return _bits != other._bits;
+  }
+
+  // these need the complete `VarBase` and are defined in Vars/Base.hpp
+  inline std::uintptr_t type() const;
+  inline std::uintptr_t typeFnId() const;
+  template <typename T> inline bool isa() const;
+  inline bool isCallable() const;
+  inline bool isAttrBased() const;
+
+  bool toStr(State &vm, std::string &data, const size_t &srcId,
+             const size_t &idx) const;
+  bool toBool(State &vm, bool &data, const size_t &srcId,
+              const size_t &idx) const;
+};
+
+static_assert(sizeof(Value) == sizeof(std::uint64_t),
+              "Value must stay a single machine word");
+
+} // namespace june
+
+#endif
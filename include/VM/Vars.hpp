@@ -5,49 +5,87 @@
 #include <unordered_map>
 #include <vector>
 
+#include "Symbols.hpp"
 #include "Vars/Base.hpp"
 
 namespace june {
 
 class VarsFrame {
-  std::unordered_map<std::string, VarBase *> _vars;
+  std::unordered_map<Symbol, Value> _vars;
 
 public:
   VarsFrame();
   ~VarsFrame();
 
-  inline const std::unordered_map<std::string, VarBase *> &vars() const {
+  inline const std::unordered_map<Symbol, Value> &vars() const {
     return _vars;
   }
 
-  inline bool exists(const std::string &name) {
+  inline bool exists(const Symbol &name) {
     return _vars.find(name) != _vars.end();
   }
-  VarBase *get(const std::string &name);
+  // an undefined value if `name` doesn't exist
+  Value get(const Symbol &name);
+  // the slot holding `name`, nullptr if it doesn't exist
+  Value *getRef(const Symbol &name);
 
-  void add(const std::string &name, VarBase *val, const bool iref);
-  void rem(const std::string &name, const bool dref);
+  void add(const Symbol &name, Value val, const bool iref);
+  void rem(const Symbol &name, const bool dref);
 
   static void *operator new(size_t sz);
   static void operator delete(void *ptr, size_t sz);
 };
 
+// The variables of one function. Scopes don't own any storage: named
+// variables of all scopes live in one array (innermost last) and a scope is
+// just a mark into it, so entering a block is a push onto `_marks` and leaving
+// it only drefs what the block created.
 class VarsStack {
+  struct Entry {
+    Symbol name;
+    Value val;
+  };
+  struct Mark {
+    // first entry of `_vars` and `_created` that belongs to the scope
+    size_t vars;
+    size_t slots;
+  };
+
+  // removed variables are left as `symbols::kNone` until their scope ends
+  std::vector<Entry> _vars;
+  std::vector<Mark> _marks;
   std::vector<size_t> _loopsFrom;
-  std::vector<VarsFrame *> _stack;
-  size_t _top;
+  // slot-resolved locals (see `passes::resolveLocals()`), they live as long
+  // as the scope they were created in
+  std::vector<Value> _slots;
+  // slots in the order they were created
+  std::vector<size_t> _created;
+
+  inline size_t top() const { return _marks.size() - 1; }
 
 public:
   VarsStack();
   ~VarsStack();
 
+  // drops all variables, the storage is kept for the next function using it
+  void reset();
+
   // checks if a variable exists in the current scope
-  bool exists(const std::string &name);
+  bool exists(const Symbol &name);
 
   // checks if a variable exists in any scope
-  bool existsGlobal(const std::string &name);
+  bool existsGlobal(const Symbol &name);
 
-  VarBase *get(const std::string &name);
+  Value get(const Symbol &name);
+  Value *getRef(const Symbol &name);
+
+  // nullptr if nothing was created in `slot` yet
+  inline Value *slot(const size_t &slot) {
+    if (slot >= _slots.size() || _slots[slot].isUndef())
+      return nullptr;
+    return &_slots[slot];
+  }
+  void setSlot(const size_t &slot, Value val, const bool iref);
 
   void incTop(const size_t &count);
   void decTop(const size_t &count);
@@ -56,26 +94,33 @@ public:
   void popLoop();
   void loopContinue();
 
-  void add(const std::string &name, VarBase *val, const bool iref);
-  void rem(const std::string &name, const bool dref);
+  void add(const Symbol &name, Value val, const bool iref);
+  void rem(const Symbol &name, const bool dref);
 };
 
 class Vars {
   size_t _fnStack;
-  std::unordered_map<std::string, VarBase *> _stash;
-  std::unordered_map<size_t, VarsStack *> _fnVars;
+  std::unordered_map<Symbol, Value> _stash;
+  // one frame per call depth, frames above `_fnStack` are kept around (empty)
+  // to be reused by the next call of that depth
+  std::vector<VarsStack *> _fnVars;
+  // `_fnVars[_fnStack]`
+  VarsStack *_cur;
 
 public:
   Vars();
   ~Vars();
 
   // checks if a variable exists in the current scope
-  bool exists(const std::string &name);
+  bool exists(const Symbol &name);
 
   // checks if a variable exists in any scope
-  bool existsGlobal(const std::string &name);
+  bool existsGlobal(const Symbol &name);
 
-  VarBase *get(const std::string &name);
+  Value get(const Symbol &name);
+  // the slot holding `name` as seen from the current scope, used to assign to
+  // inline values in place
+  Value *getRef(const Symbol &name);
 
   void blkAdd(const size_t &count);
   void blkRem(const size_t &count);
@@ -83,17 +128,23 @@ public:
   void pushFn();
   void popFn();
 
-  void stash(const std::string &name, VarBase *val, const bool &iref = true);
+  // variables of the function currently being executed
+  inline VarsStack *fnVars() { return _cur; }
+  // the frame the next `pushFn()` switches to, arguments of a call are put
+  // there before its body starts
+  VarsStack *nextFn();
+
+  void stash(const Symbol &name, Value val, const bool &iref = true);
   void unstash();
 
-  inline void pushLoop() { _fnVars[_fnStack]->pushLoop(); }
-  inline void popLoop() { _fnVars[_fnStack]->popLoop(); }
-  inline void loopContinue() { _fnVars[_fnStack]->loopContinue(); }
+  inline void pushLoop() { _cur->pushLoop(); }
+  inline void popLoop() { _cur->popLoop(); }
+  inline void loopContinue() { _cur->loopContinue(); }
 
-  void add(const std::string &name, VarBase *val, const bool &iref);
+  void add(const Symbol &name, Value val, const bool &iref);
   // add a variable to module level unconditionally
-  void addm(const std::string &name, VarBase *val, const bool &iref);
-  void rem(const std::string &name, const bool &dref);
+  void addm(const Symbol &name, Value val, const bool &iref);
+  void rem(const Symbol &name, const bool &dref);
 };
 
 } // namespace june
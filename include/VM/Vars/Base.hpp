@@ -1,14 +1,17 @@
 #ifndef vm_vars_base_hpp
 #define vm_vars_base_hpp
 
+#include <atomic>
 #include <cassert>
 #include <cstdint>
-#include <mutex>
 #include <string>
 #include <unordered_map>
+#include <utility>
 #include <vector>
 
 #include "../SrcFile.hpp"
+#include "../Symbols.hpp"
+#include "../Value.hpp"
 
 namespace june {
 
@@ -17,15 +20,18 @@ enum VarInfo {
   ViAttrBased = 1 << 1,
   ViLoadAsRef = 1 << 2,
   // ViUnmanaged = 1 << 3
+  ViShared = 1 << 4,
+  ViConst = 1 << 5,
 };
 
 struct State;
 class VarBase {
-  std::mutex mtx; // TODO: remove/replace
   std::uintptr_t _type;
   size_t _srcId;
   size_t _idx;
-  size_t _refCount;
+  // only updated atomically once the object is shared (see `share()`), until
+  // then it behaves like a plain integer
+  std::atomic<size_t> _refCount;
 
   char _info;
 
@@ -69,18 +75,39 @@ public:
   inline size_t idx() const { return _idx; }
 
   inline void iref() {
-    std::lock_guard<std::mutex> lock(mtx);
-    _refCount++;
+    if (_info & VarInfo::ViShared) {
+      _refCount.fetch_add(1, std::memory_order_relaxed);
+      return;
+    }
+    _refCount.store(_refCount.load(std::memory_order_relaxed) + 1,
+                    std::memory_order_relaxed);
   }
 
+  // returns the remaining count, the caller owns the object once it hits 0
   inline size_t dref() {
-    std::lock_guard<std::mutex> lock(mtx);
-    assert(_refCount > 0);
-    _refCount--;
-    return _refCount;
+    if (_info & VarInfo::ViShared) {
+      size_t prev = _refCount.fetch_sub(1, std::memory_order_acq_rel);
+      assert(prev > 0);
+      return prev - 1;
+    }
+    size_t count = _refCount.load(std::memory_order_relaxed);
+    assert(count > 0);
+    _refCount.store(count - 1, std::memory_order_relaxed);
+    return count - 1;
   }
 
-  inline size_t refCount() const { return _refCount; }
+  inline size_t refCount() const {
+    return _refCount.load(std::memory_order_relaxed);
+  }
+
+  // Switches the object (and anything it holds) to atomic refcounting. Must
+  // be called before the object becomes reachable from another thread.
+  virtual void share();
+  inline bool isShared() const { return _info & VarInfo::ViShared; }
+
+  // constant pool entries, never written to (assignments rebind instead)
+  inline bool isConst() const { return _info & VarInfo::ViConst; }
+  inline void setConst() { _info |= VarInfo::ViConst; }
 
   inline bool isCallable() const { return _info & VarInfo::ViCallable; }
   inline bool isAttrBased() const { return _info & VarInfo::ViAttrBased; }
@@ -89,12 +116,16 @@ public:
   inline void setLoadAsRef() { _info |= VarInfo::ViLoadAsRef; }
   inline void unsetLoadAsRef() { _info &= ~VarInfo::ViLoadAsRef; }
 
-  virtual VarBase *call(State &vm, const std::vector<VarBase *> &args,
-                        const size_t &srcId, const size_t &idx);
+  // `args[0]` is the context (`self`), undefined if there is none. Returns the
+  // result with a reference owned by the caller, or an undefined value if the
+  // call failed.
+  virtual Value call(State &vm, const std::vector<Value> &args,
+                     const size_t &srcId, const size_t &idx);
 
-  virtual bool attrExists(const std::string &attr) const;
-  virtual void attrSet(const std::string &attr, VarBase *val, const bool iref);
-  virtual VarBase *attrGet(const std::string &attr);
+  virtual bool attrExists(const Symbol &attr) const;
+  virtual void attrSet(const Symbol &attr, Value val, const bool iref);
+  // an undefined value if the attribute doesn't exist
+  virtual Value attrGet(const Symbol &attr);
 
   static void *operator new(size_t sz);
   static void operator delete(void *ptr, size_t sz);
@@ -113,8 +144,7 @@ template <typename T> inline void varIref(T *var) {
 template <typename T> inline void varDref(T *&var) {
   if (var == nullptr)
     return;
-  var->dref();
-  if (var->refCount() == 0) {
+  if (var->dref() == 0) {
     delete var;
     var = nullptr;
   }
@@ -124,12 +154,50 @@ template <typename T> inline void varDref(T *&var) {
 template <typename T> inline void varDrefConst(const T *var) {
   if (var == nullptr)
     return;
-  var->dref();
-  if (var->refCount() == 0) {
+  if (const_cast<T *>(var)->dref() == 0) {
     delete var;
   }
 }
 
+// Storage shared by copies of a var until one of them writes to it (copy on
+// write). The count is always atomic, copies may end up on different threads
+// even when the vars themselves are not shared.
+template <typename T> struct VarBuf {
+  std::atomic<size_t> refs;
+  T data;
+
+  explicit VarBuf(T data) : refs(1), data(std::move(data)) {}
+
+  inline void iref() { refs.fetch_add(1, std::memory_order_relaxed); }
+  // true if that was the last reference, the caller then deletes the buffer
+  inline bool dref() {
+    return refs.fetch_sub(1, std::memory_order_acq_rel) == 1;
+  }
+  inline bool unique() const {
+    return refs.load(std::memory_order_acquire) == 1;
+  }
+};
+
+// The text of a `VarString` once it's shared, never written to while more than
+// one string refers to it. The hash is computed once and kept. Interned buffers
+// are never freed and exist once per distinct text, so two interned buffers
+// hold equal text only if they're the same buffer.
+struct StrBuf : public VarBuf<std::string> {
+  // 0 until computed
+  std::atomic<size_t> hash;
+  const bool interned;
+  // the text as a name, only cached for interned buffers
+  std::atomic<Symbol> sym;
+
+  StrBuf(std::string data, const bool &interned)
+      : VarBuf<std::string>(std::move(data)), hash(0), interned(interned),
+        sym(symbols::kNone) {}
+
+  // The one interned buffer holding `data`, with a reference owned by the
+  // caller. Used for string constants, which are never written to.
+  static StrBuf *intern(const std::string &data);
+};
+
 class VarAll : public VarBase {
 public:
   VarAll(const size_t &srcId, const size_t &idx);
@@ -203,43 +271,241 @@ public:
 };
 #define AsFloat(x) static_cast<VarFloat *>(x)
 
+// A string built by concatenation, the pieces are only copied together once
+// the text is needed. Either a leaf holding `text`, or `left` followed by
+// `right`. Nodes are never changed and shared between strings.
+struct StrRope {
+  std::atomic<size_t> refs;
+  size_t size;
+  StrBuf *text;
+  StrRope *left;
+  StrRope *right;
+
+  StrRope(const size_t &size, StrBuf *text, StrRope *left, StrRope *right)
+      : refs(1), size(size), text(text), left(left), right(right) {}
+
+  inline void iref() { refs.fetch_add(1, std::memory_order_relaxed); }
+  // drops a reference, along with anything only this node kept alive
+  static void release(StrRope *node);
+};
+
+// strings up to this long are copied rather than shared, they fit into
+// `std::string`'s inline buffer
+static constexpr size_t kInlineStrSize = 15;
+// concatenations up to this long are copied right away instead of building a
+// rope
+static constexpr size_t kMinRopeSize = 128;
+
 class VarString : public VarBase {
-  std::string _data;
+  // the text when it isn't shared or a rope (both null), inline if it's short
+  mutable std::string _own;
+  mutable StrBuf *_buf;
+  // pieces not yet concatenated, flattened into `_own` on first read
+  mutable StrRope *_rope;
+
+  VarString(StrRope *rope, const size_t &srcId, const size_t &idx);
+  void release() const;
+  void flatten() const;
+  // a reference to this string as a rope node
+  StrRope *asRope();
 
 public:
   VarString(const std::string &val, const size_t &srcId, const size_t &idx);
+  // takes over a reference to `buf`
+  VarString(StrBuf *buf, const size_t &srcId, const size_t &idx);
+  ~VarString();
 
+  // short strings are copied, longer ones shared until either side writes
   VarBase *copy(const size_t &srcId, const size_t &idx);
   void set(VarBase *from);
 
-  std::string &get();
+  inline const std::string &get() const {
+    if (_rope)
+      flatten();
+    return _buf ? _buf->data : _own;
+  }
+  // for writing, makes a private copy first if the string is shared
+  std::string &getMut();
+  // the length, without flattening a rope
+  size_t size() const;
+
+  // `lhs` followed by `rhs`, with a reference owned by the caller. Long
+  // results are ropes, so building a string piece by piece stays linear.
+  static VarString *concat(VarString *lhs, VarString *rhs, const size_t &srcId,
+                           const size_t &idx);
+
+  // flattens first, a rope may not be flattened by two threads at once
+  void share();
+
+  size_t hash();
+  bool equals(VarString *other);
+  // the string as a name
+  Symbol symbol();
 };
 #define AsString(x) static_cast<VarString *>(x)
 
+// Text appended to in place, for building a string from many pieces without
+// a `VarString` for every step in between.
+class VarStrBuilder : public VarBase {
+  std::string _data;
+
+public:
+  VarStrBuilder(const std::string &val, const size_t &srcId,
+                const size_t &idx);
+
+  VarBase *copy(const size_t &srcId, const size_t &idx);
+  void set(VarBase *from);
+
+  std::string &get();
+};
+#define AsStrBuilder(x) static_cast<VarStrBuilder *>(x)
+
+enum VecKind : char {
+  VkVars,
+  VkInt,
+  VkFloat,
+  VkBool,
+};
+
+// The elements of a `VarVec`. A vector holding nothing but inline ints, floats
+// or bools keeps them unboxed and contiguous (only the member for its kind is
+// used), anything else is a vector of vars.
+struct VecData {
+  VecKind kind;
+  // owns a reference to every element
+  std::vector<VarBase *> vars;
+  // all fit inline, see `Value::fitsInt()`
+  std::vector<long long> ints;
+  std::vector<double> floats;
+  // 64 to a word, `bools` of them are used
+  std::vector<std::uint64_t> bits;
+  size_t bools;
+
+  explicit VecData(const VecKind &kind = VkVars) : kind(kind), bools(0) {}
+  explicit VecData(const std::vector<VarBase *> &vars)
+      : kind(VkVars), vars(vars), bools(0) {}
+
+  inline bool boolAt(const size_t &i) const {
+    return (bits[i / 64] >> (i % 64)) & 1;
+  }
+  void pushBool(const bool &val);
+};
+
 class VarVec : public VarBase {
-  std::vector<VarBase *> _data;
+  VarBuf<VecData> *_data;
   bool _refs;
 
+  VarVec(VarBuf<VecData> *data, const bool &refs, const size_t &srcId,
+         const size_t &idx);
+  void release();
+  // the data for writing, copied first if it's still shared
+  VecData &mutData();
+  // boxes typed elements so the vector can hold anything
+  void toVars();
+
 public:
+  // takes over the references held by `val`
   VarVec(const std::vector<VarBase *> &val, const bool &refs,
          const size_t &srcId, const size_t &idx);
+  // a typed (or any other non reference) vector holding `data`
+  VarVec(VecData data, const size_t &srcId, const size_t &idx);
   ~VarVec();
 
+  // shares the elements until either side writes to the vector
   VarBase *copy(const size_t &srcId, const size_t &idx);
   void set(VarBase *from);
 
-  void attrSet(const std::string &attr, VarBase *val, const bool iref);
-  VarBase *attrGet(const std::string &attr);
-  bool attrExists(const std::string &attr) const;
-
-  std::vector<VarBase *> &get();
+  void share();
+
+  void attrSet(const Symbol &attr, Value val, const bool iref);
+  Value attrGet(const Symbol &attr);
+  bool attrExists(const Symbol &attr) const;
+
+  inline const VecData &data() const { return _data->data; }
+  inline VecKind kind() const { return _data->data.kind; }
+  size_t size() const;
+  // the element at `i` (borrowed), typed elements need no boxing
+  Value at(const size_t &i) const;
+  // Appends `val`. A var is copied unless it's a temporary (only the caller
+  // holds it) or this is a vector of references. An empty vector takes on
+  // the kind of its first element, anything that doesn't fit the kind turns
+  // it into a vector of vars.
+  void push(const Value &val);
+
+  // The elements as vars, boxing typed elements first. For writing, makes a
+  // private copy first if the elements are still shared. Unless this is a
+  // vector of references the copy gets its own copies of the elements, so
+  // elements must only be changed in place through `getMut()`.
+  const std::vector<VarBase *> &get();
+  std::vector<VarBase *> &getMut();
   bool isRefVec();
 };
 #define AsVec(x) static_cast<VarVec *>(x)
 
+// One key and value of a `VarMap`, the key is undefined once it's removed.
+struct MapEntry {
+  Value key;
+  Value val;
+  size_t hash;
+};
+
+// The entries of a `VarMap` in insertion order, along with an open addressing
+// index into them. The index is probed a group of `kMapGroup` slots at a time,
+// with a control byte per slot telling whether it's empty, removed or which
+// low hash bits the entry it points to has.
+struct MapData {
+  std::vector<MapEntry> entries;
+  std::vector<std::uint8_t> ctrl;
+  std::vector<std::uint32_t> slots;
+  // live entries, `entries` may hold removed ones until the next rehash
+  size_t count;
+
+  MapData() : count(0) {}
+};
+
+class VarMap : public VarBase {
+  VarBuf<MapData> *_data;
+
+  VarMap(VarBuf<MapData> *data, const size_t &srcId, const size_t &idx);
+  void release();
+  // the data for writing, copied first if it's still shared
+  MapData &mutData();
+
+public:
+  VarMap(const size_t &srcId, const size_t &idx);
+  ~VarMap();
+
+  // shares the entries until either side writes to the map
+  VarBase *copy(const size_t &srcId, const size_t &idx);
+  void set(VarBase *from);
+  void share();
+
+  void attrSet(const Symbol &attr, Value val, const bool iref);
+  Value attrGet(const Symbol &attr);
+  bool attrExists(const Symbol &attr) const;
+
+  inline const MapData &data() const { return _data->data; }
+  inline size_t size() const { return _data->data.count; }
+
+  // The value for `key` (borrowed), undefined if there is none. Strings and
+  // ints (or floats, bools and nil) are compared by value, anything else by
+  // identity.
+  Value get(const Value &key) const;
+  // Sets `key` to `val`. A new key is copied if it's a string so changing it
+  // later can't change the key in the map, `val` is copied unless it's a
+  // temporary, the same as `VarVec::push()`.
+  void put(const Value &key, const Value &val);
+  // false if there was no `key`
+  bool remove(const Value &key);
+};
+#define AsMap(x) static_cast<VarMap *>(x)
+
 struct FnBodySpan {
   size_t begin;
   size_t end;
+  // whether `self` and the arguments are passed in slots, see
+  // `SrcFile::argsInSlots()`
+  bool argSlots;
 };
 
 // TODO: assn args? ex. fn(x, y, arg = z)
@@ -263,18 +529,45 @@ struct FnData {
 
 typedef VarBase *(*NativeFnPtr)(State &vm, const FnData &data);
 
+// natives registered with a fixed number of arguments, up to this many
+static constexpr size_t kMaxFixedArity = 4;
+
+// The arguments of a fixed arity native, viewed in place in the caller's
+// argument buffer rather than copied: `args[0]` is the context (undefined if
+// there is none), followed by exactly as many values as the native was
+// registered with. Inline values are not boxed.
+struct NativeArgs {
+  size_t srcId;
+  size_t idx;
+  const Value *args;
+  size_t count;
+
+  inline const Value &operator[](const size_t &i) const { return args[i]; }
+  inline size_t size() const { return count; }
+};
+
+// Same contract as `NativeFnPtr`: the result is either borrowed or newly
+// created, an undefined value means failure.
+typedef Value (*NativeFixedFnPtr)(State &vm, const NativeArgs &args);
+
 union FnBody {
   NativeFnPtr native;
+  NativeFixedFnPtr fixed;
   FnBodySpan june;
 };
 
 class VarFunc : public VarBase {
   std::string _srcName;
   std::vector<std::string> _args;
+  // interned `_srcName` and `_args`, used on every call
+  Symbol _srcSym;
+  std::vector<Symbol> _argSyms;
   // std::unordered_map<std::string, VarBase *> _assnArgs;
   FnBody _body;
   std::string _varArg;
   bool _isNative;
+  // `_body.fixed` is set instead of `_body.native`
+  bool _isFixed;
 
 public:
   VarFunc(const std::string &srcName,
@@ -282,6 +575,9 @@ public:
           // const std::unordered_map<std::string, VarBase *> &assnArgs,
           const FnBody &body, const bool isNative, const size_t &srcId,
           const size_t &idx);
+  // a fixed arity native taking `argsCount` arguments
+  VarFunc(const std::string &srcName, const size_t &argsCount,
+          NativeFixedFnPtr fn, const size_t &srcId, const size_t &idx);
 
   VarBase *copy(const size_t &srcId, const size_t &idx);
   void set(VarBase *from);
@@ -289,13 +585,13 @@ public:
   bool isNative() const;
   bool isJune() const;
 
-  std::string &srcName();
+  const std::string &srcName() const;
   std::string &varArg();
-  std::vector<std::string> &args();
+  const std::vector<std::string> &args() const;
   FnBody &body();
 
-  VarBase *call(State &vm, const std::vector<VarBase *> &args,
-                const size_t &srcId, const size_t &idx);
+  Value call(State &vm, const std::vector<Value> &args, const size_t &srcId,
+             const size_t &idx);
 };
 #define AsFunc(x) static_cast<VarFunc *>(x)
 
@@ -313,12 +609,14 @@ public:
   VarBase *copy(const size_t &srcId, const size_t &idx);
   void set(VarBase *from);
 
-  bool attrExists(const std::string &name) const;
-  void attrSet(const std::string &name, VarBase *val, const bool iref);
-  VarBase *attrGet(const std::string &name);
+  bool attrExists(const Symbol &name) const;
+  void attrSet(const Symbol &name, Value val, const bool iref);
+  Value attrGet(const Symbol &name);
 
   void addNativeFn(const std::string &name, NativeFnPtr fn,
                    const size_t &argsCount = 0, const bool &isVarArgs = false);
+  void addNativeFn(const std::string &name, NativeFixedFnPtr fn,
+                   const size_t &argsCount);
   void addNativeVar(const std::string &name, VarBase *var,
                     const bool iref = true, const bool moduleLevel = false);
 
@@ -327,6 +625,70 @@ public:
 };
 #define AsSrc(x) static_cast<VarSrc *>(x)
 
+// Value
+
+inline Value Value::fromInt(const long long &val) {
+  if (fitsInt(val))
+    return Value(kTagInt | (static_cast<std::uint64_t>(val) & kPayloadMask));
+  VarInt *res = new VarInt(val, 0, 0);
+  res->dref();
+  return fromVar(res);
+}
+
+inline std::uintptr_t Value::type() const {
+  if (isVar())
+    return asVar()->type();
+  if (isInt())
+    return type_id<VarInt>();
+  if (isFloat())
+    return type_id<VarFloat>();
+  if (isBool())
+    return type_id<VarBool>();
+  if (isNil())
+    return type_id<VarNil>();
+  return 0;
+}
+
+inline std::uintptr_t Value::typeFnId() const {
+  return isVar() ? asVar()->typeFnId() : type();
+}
+
+template <typename T> inline bool Value::isa() const {
+  return type() == type_id<T>();
+}
+
+inline bool Value::isCallable() const {
+  return isVar() && asVar()->isCallable();
+}
+
+inline bool Value::isAttrBased() const {
+  return isVar() && asVar()->isAttrBased();
+}
+
+// inline values and constants can't be written through, assigning to a name
+// or attribute holding one replaces what it holds instead
+inline bool valReadOnly(const Value &val) {
+  return val.isImmediate() || (val.isVar() && val.asVar()->isConst());
+}
+
+inline void valIref(const Value &val) {
+  if (val.isVar())
+    val.asVar()->iref();
+}
+
+inline void valDref(Value &val) {
+  if (!val.isVar())
+    return;
+  VarBase *var = val.asVar();
+  varDref(var);
+  if (var == nullptr)
+    val = Value();
+}
+
+// Converts a heap `int`, `float`, `bool` or `nil` into its inline form,
+// anything else is wrapped as is. References to `var` are left untouched.
+Value unbox(VarBase *var);
+
 void initTypenames(State &vm);
 
 } // namespace june
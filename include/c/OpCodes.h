@@ -48,6 +48,37 @@ enum OpCodes {
                    // OpPushJump)
   OpPopJump, // unmarks the position to jump to if `or` exists in an expression
 
+  OpNop,        // does nothing, removed before execution
+  OpLoadSlot,   // load a function local from slot `n`
+  OpCreateSlot, // create a function local in slot `n`
+
+  // binary operators: pop the right, then the left operand and push the
+  // result
+  OpAdd,
+  OpSub,
+  OpMul,
+  OpDiv,
+  OpMod,
+  OpLt,
+  OpLe,
+  OpGt,
+  OpGe,
+  OpEq,
+  OpNe,
+
+  // compound assignments to the function local in slot `n`
+  OpIncSlot,
+  OpDecSlot,
+  OpAddSlot,
+  OpSubSlot,
+
+  // superinstructions, followed by the instructions they stand for
+  OpLoadLoadCall,
+  OpLoadJumpFalse,
+  OpCmpJumpFalse,
+  OpCallUnload,
+  OpMemberCallUnload,
+
   _OpLast
 };
 
@@ -56,7 +87,12 @@ static const char *OpCodeCStrs[_OpLast] = {
     "JumpTrue",      "JumpFalse", "JumpTruePop", "JumpFalsePop", "JumpNil",
     "BodyMarker",    "MakeFunc",  "BlkA",        "BlkR",         "Call",
     "MemberCall",    "Attr",  "Return",     "PushLoop",    "PopLoop", "Continue", "Break",      "PushJump",
-    "PushJumpNamed", "PopJump"};
+    "PushJumpNamed", "PopJump", "Nop", "LoadSlot", "CreateSlot",
+    "Add",           "Sub",     "Mul", "Div",      "Mod",
+    "Lt",            "Le",      "Gt",  "Ge",       "Eq",
+    "Ne",            "IncSlot", "DecSlot", "AddSlot", "SubSlot",
+    "LoadLoadCall",  "LoadJumpFalse", "CmpJumpFalse", "CallUnload",
+    "MemberCallUnload"};
 
 enum OpDataType {
   OdtInt,
@@ -66,12 +102,15 @@ enum OpDataType {
   OdtSize,
   OdtBool,
   OdtNil,
+  OdtConst,
+  OdtSymbol,
 
   _OdtLast
 };
 
 static const char *OpDataTypeCStrs[_OdtLast] = {
-    "Int", "Float", "String", "Ident", "Size", "Bool", "Nil"};
+    "Int",  "Float", "String", "Ident",
+    "Size", "Bool",  "Nil",    "Const", "Symbol"};
 
 union OpData {
   double f;
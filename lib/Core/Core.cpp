@@ -1,3 +1,4 @@
+#include <VM/Kernels.hpp>
 #include <VM/State.hpp>
 #include <cstdio>
 
@@ -16,43 +17,427 @@ VarBase *print(State &vm, const FnData &fd) {
   return vm.nil;
 }
 
-VarBase *import(State &vm, const FnData &fd) {
-  VarBase *entry = fd.args[1];
-  if (!entry->isa<VarString>()) {
-    vm.fail(entry->srcId(), entry->idx(),
+Value import(State &vm, const NativeArgs &args) {
+  if (!args[1].isa<VarString>()) {
+    vm.fail(args.srcId, args.idx,
             "expected argument to be of type string, found: %s",
-            vm.getTypeName(entry->type()).c_str());
-    return nullptr;
+            vm.getTypeName(args[1]).c_str());
+    return Value();
   }
-  VarString *importFile = entry->as<VarString>();
+  // the module load resolves the name in place, and the argument may well be
+  // a pooled constant, so work on a copy
+  std::string path = args[1].asVar()->as<VarString>()->get();
 
-  auto err = vm.juneModuleLoad(importFile->get(), fd.srcId, fd.idx);
+  auto err = vm.juneModuleLoad(path, args.srcId, args.idx);
   if (err.isErr()) {
-    vm.fail(fd.srcId, fd.idx, "failed to import module '%s': %s",
-            importFile->get().c_str(), err.unwrapErr().toString().c_str());
-    return nullptr;
+    vm.fail(args.srcId, args.idx, "failed to import module '%s': %s",
+            path.c_str(), err.unwrapErr().toString().c_str());
+    return Value();
   }
 
-  return vm.allSrcs[importFile->get()];
+  return Value::fromVar(vm.allSrcs[symbols::intern(path)]);
 }
 
-VarBase *importNative(State &vm, const FnData &fd) {
-  VarBase *entry = fd.args[1];
-  if (!entry->isa<VarString>()) {
-    vm.fail(entry->srcId(), entry->idx(),
+Value importNative(State &vm, const NativeArgs &args) {
+  if (!args[1].isa<VarString>()) {
+    vm.fail(args.srcId, args.idx,
             "expected argument to be of type string, found: %s",
-            vm.getTypeName(entry->type()).c_str());
-    return nullptr;
+            vm.getTypeName(args[1]).c_str());
+    return Value();
   }
-  VarString *importFile = entry->as<VarString>();
+  VarString *importFile = args[1].asVar()->as<VarString>();
 
-  if (!vm.nativeModuleLoad(importFile->get(), fd.srcId, fd.idx)) {
-    vm.fail(fd.srcId, fd.idx, "failed to load native module '%s'",
+  if (!vm.nativeModuleLoad(importFile->get(), args.srcId, args.idx)) {
+    vm.fail(args.srcId, args.idx, "failed to load native module '%s'",
             importFile->get().c_str());
+    return Value();
+  }
+
+  return Value::nil();
+}
+
+static bool isBuilder(State &vm, const NativeArgs &args) {
+  if (args[0].isa<VarStrBuilder>())
+    return true;
+  vm.fail(args.srcId, args.idx, "expected a StringBuilder, found: %s",
+          vm.getTypeName(args[0]).c_str());
+  return false;
+}
+
+Value stringBuilder(State &vm, const NativeArgs &args) {
+  return Value::fromVar(make_all<VarStrBuilder>("", args.srcId, args.idx));
+}
+
+// appends the text of the argument in place and returns the builder itself
+Value builderAppend(State &vm, const NativeArgs &args) {
+  if (!isBuilder(vm, args))
+    return Value();
+  std::string &data = AsStrBuilder(args[0].asVar())->get();
+  if (args[1].isa<VarString>()) {
+    data += AsString(args[1].asVar())->get();
+  } else if (args[1].isInt()) {
+    data += std::to_string(args[1].asInt());
+  } else {
+    std::string str;
+    if (!args[1].toStr(vm, str, args.srcId, args.idx))
+      return Value();
+    data += str;
+  }
+  return args[0];
+}
+
+Value builderStr(State &vm, const NativeArgs &args) {
+  if (!isBuilder(vm, args))
+    return Value();
+  return Value::fromVar(make_all<VarString>(
+      AsStrBuilder(args[0].asVar())->get(), args.srcId, args.idx));
+}
+
+Value builderLen(State &vm, const NativeArgs &args) {
+  if (!isBuilder(vm, args))
+    return Value();
+  return Value::fromInt((long long)AsStrBuilder(args[0].asVar())->get().size());
+}
+
+Value builderClear(State &vm, const NativeArgs &args) {
+  if (!isBuilder(vm, args))
+    return Value();
+  AsStrBuilder(args[0].asVar())->get().clear();
+  return args[0];
+}
+
+// builds a vector out of the arguments, unboxed if they are all ints, all
+// floats or all bools
+VarBase *vec(State &vm, const FnData &fd) {
+  VarVec *res = make_all<VarVec>(VecData(), fd.srcId, fd.idx);
+  for (size_t i = 1; i < fd.args.size(); ++i)
+    res->push(unbox(fd.args[i]));
+  return res;
+}
+
+static bool isVec(State &vm, const NativeArgs &args) {
+  if (args[0].isa<VarVec>())
+    return true;
+  vm.fail(args.srcId, args.idx, "expected a Vec, found: %s",
+          vm.getTypeName(args[0]).c_str());
+  return false;
+}
+
+static Value newVec(VecData &&data, const NativeArgs &args) {
+  VarVec *res = new VarVec(std::move(data), args.srcId, args.idx);
+  res->dref();
+  return Value::fromVar(res);
+}
+
+// The elements of a vector of numbers, in place if it's typed. A vector of
+// vars is gathered into `own*` first, as ints if they all are.
+struct Nums {
+  bool isInt = true;
+  size_t n = 0;
+  const long long *ints = nullptr;
+  const double *floats = nullptr;
+  std::vector<long long> ownInts;
+  std::vector<double> ownFloats;
+
+  void toFloats() {
+    if (!isInt)
+      return;
+    ownFloats.assign(ints, ints + n);
+    floats = ownFloats.data();
+    isInt = false;
+  }
+};
+
+static bool getNums(State &vm, const NativeArgs &args, VarVec *vec,
+                    Nums &res) {
+  const VecData &data = vec->data();
+  res.n = vec->size();
+  res.isInt = data.kind != VkFloat;
+  res.ints = data.ints.data();
+  res.floats = data.floats.data();
+  if (data.kind == VkInt || data.kind == VkFloat)
+    return true;
+  for (size_t i = 0; i < res.n; ++i) {
+    Value val = vec->at(i);
+    if (val.isVar())
+      val = unbox(val.asVar());
+    if (val.isInt() && res.isInt) {
+      res.ownInts.push_back(val.asInt());
+    } else if (val.isInt() || val.isFloat()) {
+      if (res.isInt)
+        res.ownFloats.assign(res.ownInts.begin(), res.ownInts.end());
+      res.isInt = false;
+      res.ownFloats.push_back(val.isInt() ? val.asInt() : val.asFloat());
+    } else {
+      vm.fail(args.srcId, args.idx, "expected a vector of numbers, found: %s",
+              vm.getTypeName(val).c_str());
+      return false;
+    }
+  }
+  res.ints = res.ownInts.data();
+  res.floats = res.ownFloats.data();
+  return true;
+}
+
+// the other operand of an element wise operation, a vector of the same size
+// or a number
+static bool getOperand(State &vm, const NativeArgs &args, const size_t &n,
+                       Nums &vec, Value &scalar) {
+  scalar = args[1].isVar() ? unbox(args[1].asVar()) : args[1];
+  if (scalar.isInt() || scalar.isFloat()) {
+    vec.n = 0;
+    return true;
+  }
+  if (!scalar.isa<VarVec>()) {
+    vm.fail(args.srcId, args.idx, "expected a Vec or a number, found: %s",
+            vm.getTypeName(args[1]).c_str());
+    return false;
+  }
+  VarVec *other = AsVec(scalar.asVar());
+  if (other->size() != n) {
+    vm.fail(args.srcId, args.idx, "expected a Vec of size %zu, found: %zu", n,
+            other->size());
+    return false;
+  }
+  return getNums(vm, args, other, vec);
+}
+
+Value vecPush(State &vm, const NativeArgs &args) {
+  if (!isVec(vm, args))
+    return Value();
+  AsVec(args[0].asVar())->push(args[1]);
+  return args[0];
+}
+
+Value vecAt(State &vm, const NativeArgs &args) {
+  if (!isVec(vm, args))
+    return Value();
+  VarVec *self = AsVec(args[0].asVar());
+  if (!args[1].isInt()) {
+    vm.fail(args.srcId, args.idx, "expected an index of type int, found: %s",
+            vm.getTypeName(args[1]).c_str());
+    return Value();
+  }
+  long long i = args[1].asInt();
+  if (i < 0 || (size_t)i >= self->size()) {
+    vm.fail(args.srcId, args.idx, "index %lld out of range for size %zu", i,
+            self->size());
+    return Value();
+  }
+  return self->at(i);
+}
+
+Value vecLen(State &vm, const NativeArgs &args) {
+  if (!isVec(vm, args))
+    return Value();
+  return Value::fromInt((long long)AsVec(args[0].asVar())->size());
+}
+
+// bools sum up to how many of them are true
+Value vecSum(State &vm, const NativeArgs &args) {
+  if (!isVec(vm, args))
+    return Value();
+  VarVec *self = AsVec(args[0].asVar());
+  if (self->kind() == VkBool)
+    return Value::fromInt(
+        (long long)kernels::count(self->data().bits.data(), self->size()));
+  Nums nums;
+  if (!getNums(vm, args, self, nums))
+    return Value();
+  if (!nums.isInt)
+    return Value::fromFloat(kernels::sum(nums.floats, nums.n));
+  long long res;
+  if (!kernels::sum(nums.ints, nums.n, res)) {
+    vm.fail(args.srcId, args.idx, "integer overflow in sum");
+    return Value();
+  }
+  return Value::fromInt(res);
+}
+
+template <bool Max> static Value vecExtreme(State &vm, const NativeArgs &args) {
+  if (!isVec(vm, args))
+    return Value();
+  Nums nums;
+  if (!getNums(vm, args, AsVec(args[0].asVar()), nums))
+    return Value();
+  if (nums.n == 0) {
+    vm.fail(args.srcId, args.idx, "%s of an empty vector", Max ? "max" : "min");
+    return Value();
+  }
+  if (nums.isInt)
+    return Value::fromInt(Max ? kernels::max(nums.ints, nums.n)
+                              : kernels::min(nums.ints, nums.n));
+  return Value::fromFloat(Max ? kernels::max(nums.floats, nums.n)
+                              : kernels::min(nums.floats, nums.n));
+}
+
+Value vecDot(State &vm, const NativeArgs &args) {
+  if (!isVec(vm, args))
+    return Value();
+  Nums lhs, rhs;
+  Value scalar;
+  if (!getNums(vm, args, AsVec(args[0].asVar()), lhs) ||
+      !getOperand(vm, args, lhs.n, rhs, scalar))
+    return Value();
+  if (!scalar.isa<VarVec>()) {
+    vm.fail(args.srcId, args.idx, "expected a Vec, found: %s",
+            vm.getTypeName(args[1]).c_str());
+    return Value();
+  }
+  if (lhs.isInt && rhs.isInt) {
+    long long res;
+    if (!kernels::dot(lhs.ints, rhs.ints, lhs.n, res)) {
+      vm.fail(args.srcId, args.idx, "integer overflow in dot product");
+      return Value();
+    }
+    return Value::fromInt(res);
+  }
+  lhs.toFloats();
+  rhs.toFloats();
+  return Value::fromFloat(kernels::dot(lhs.floats, rhs.floats, lhs.n));
+}
+
+// element wise arithmetic, ints stay ints unless the other side is a float
+template <kernels::MapOp Op>
+static Value vecMap(State &vm, const NativeArgs &args) {
+  if (!isVec(vm, args))
+    return Value();
+  Nums lhs, rhs;
+  Value scalar;
+  if (!getNums(vm, args, AsVec(args[0].asVar()), lhs) ||
+      !getOperand(vm, args, lhs.n, rhs, scalar))
+    return Value();
+  bool withVec = scalar.isVar();
+  if (lhs.isInt && (withVec ? rhs.isInt : scalar.isInt())) {
+    VecData res(VkInt);
+    res.ints.resize(lhs.n);
+    if (!kernels::map(Op, lhs.ints, withVec ? rhs.ints : nullptr,
+                      withVec ? 0 : scalar.asInt(), res.ints.data(), lhs.n)) {
+      // only products can overflow
+      vm.fail(args.srcId, args.idx, "integer overflow in element wise mul");
+      return Value();
+    }
+    if (kernels::fitInline(res.ints.data(), lhs.n))
+      return newVec(std::move(res), args);
+    // some results need a heap int, so they can't stay unboxed
+    VarVec *boxed = make_all<VarVec>(VecData(), args.srcId, args.idx);
+    for (auto &i : res.ints)
+      boxed->push(Value::fromInt(i));
+    return Value::fromVar(boxed);
+  }
+  lhs.toFloats();
+  rhs.toFloats();
+  VecData res(VkFloat);
+  res.floats.resize(lhs.n);
+  double with = scalar.isFloat() ? scalar.asFloat() : scalar.asInt();
+  kernels::map(Op, lhs.floats, withVec ? rhs.floats : nullptr, with,
+               res.floats.data(), lhs.n);
+  return newVec(std::move(res), args);
+}
+
+// element wise comparison, gives a vector of bools
+template <kernels::CmpOp Op>
+static Value vecCompare(State &vm, const NativeArgs &args) {
+  if (!isVec(vm, args))
+    return Value();
+  Nums lhs, rhs;
+  Value scalar;
+  if (!getNums(vm, args, AsVec(args[0].asVar()), lhs) ||
+      !getOperand(vm, args, lhs.n, rhs, scalar))
+    return Value();
+  bool withVec = scalar.isVar();
+  VecData res(VkBool);
+  res.bits.resize((lhs.n + 63) / 64);
+  res.bools = lhs.n;
+  if (lhs.isInt && (withVec ? rhs.isInt : scalar.isInt())) {
+    kernels::compare(Op, lhs.ints, withVec ? rhs.ints : nullptr,
+                     withVec ? 0 : scalar.asInt(), res.bits.data(), lhs.n);
+    return newVec(std::move(res), args);
+  }
+  lhs.toFloats();
+  rhs.toFloats();
+  double with = scalar.isFloat() ? scalar.asFloat() : scalar.asInt();
+  kernels::compare(Op, lhs.floats, withVec ? rhs.floats : nullptr, with,
+                   res.bits.data(), lhs.n);
+  return newVec(std::move(res), args);
+}
+
+// builds a map out of alternating keys and values
+VarBase *map(State &vm, const FnData &fd) {
+  if (fd.args.size() % 2 == 0) {
+    vm.fail(fd.srcId, fd.idx,
+            "expected pairs of keys and values, found %zu arguments",
+            fd.args.size() - 1);
     return nullptr;
   }
+  VarMap *res = make_all<VarMap>(fd.srcId, fd.idx);
+  for (size_t i = 1; i < fd.args.size(); i += 2)
+    res->put(unbox(fd.args[i]), unbox(fd.args[i + 1]));
+  return res;
+}
 
-  return vm.nil;
+static bool isMap(State &vm, const NativeArgs &args) {
+  if (args[0].isa<VarMap>())
+    return true;
+  vm.fail(args.srcId, args.idx, "expected a Map, found: %s",
+          vm.getTypeName(args[0]).c_str());
+  return false;
+}
+
+// nil if there is no such key, see `has` to tell the two apart
+Value mapGet(State &vm, const NativeArgs &args) {
+  if (!isMap(vm, args))
+    return Value();
+  Value res = AsMap(args[0].asVar())->get(args[1]);
+  return res.isUndef() ? Value::nil() : res;
+}
+
+Value mapSet(State &vm, const NativeArgs &args) {
+  if (!isMap(vm, args))
+    return Value();
+  AsMap(args[0].asVar())->put(args[1], args[2]);
+  return args[0];
+}
+
+Value mapHas(State &vm, const NativeArgs &args) {
+  if (!isMap(vm, args))
+    return Value();
+  return Value::fromBool(!AsMap(args[0].asVar())->get(args[1]).isUndef());
+}
+
+// whether there was such a key
+Value mapRemove(State &vm, const NativeArgs &args) {
+  if (!isMap(vm, args))
+    return Value();
+  return Value::fromBool(AsMap(args[0].asVar())->remove(args[1]));
+}
+
+Value mapLen(State &vm, const NativeArgs &args) {
+  if (!isMap(vm, args))
+    return Value();
+  return Value::fromInt((long long)AsMap(args[0].asVar())->size());
+}
+
+// the keys (or values) in the order they were first set
+template <bool Keys> static Value mapList(State &vm, const NativeArgs &args) {
+  if (!isMap(vm, args))
+    return Value();
+  VarVec *res = make_all<VarVec>(VecData(), args.srcId, args.idx);
+  for (auto &e : AsMap(args[0].asVar())->data().entries) {
+    if (e.key.isUndef())
+      continue;
+    const Value &item = Keys ? e.key : e.val;
+    if (!item.isVar()) {
+      res->push(item);
+      continue;
+    }
+    // the map's own vars are handed out as copies, writing to an element must
+    // not change the map
+    Value copy = Value::fromVar(item.asVar()->copy(args.srcId, args.idx));
+    res->push(copy);
+    valDref(copy);
+  }
+  return Value::fromVar(res);
 }
 
 extern "C" bool june_init(State &vm, const size_t srcId, const size_t &idx) {
@@ -60,11 +445,46 @@ extern "C" bool june_init(State &vm, const size_t srcId, const size_t &idx) {
 
   vm.globalAdd("print", new VarFunc(srcName, ".", {}, {.native = print}, true,
                                     srcId, idx));
-  vm.globalAdd("import", new VarFunc(srcName, "", {""}, {.native = import},
-                                     true, srcId, idx));
-  vm.globalAdd("importNative", new VarFunc(srcName, "", {""},
-                                                {.native = importNative},
-                                                true, srcId, idx));
+  vm.globalAdd("import", new VarFunc(srcName, 1, import, srcId, idx));
+  vm.globalAdd("importNative",
+               new VarFunc(srcName, 1, importNative, srcId, idx));
+
+  vm.globalAdd("stringBuilder",
+               new VarFunc(srcName, 0, stringBuilder, srcId, idx));
+  vm.addNativeTypeFn<VarStrBuilder>("append", builderAppend, 1, srcId, idx);
+  vm.addNativeTypeFn<VarStrBuilder>("str", builderStr, 0, srcId, idx);
+  vm.addNativeTypeFn<VarStrBuilder>("toStr", builderStr, 0, srcId, idx);
+  vm.addNativeTypeFn<VarStrBuilder>("len", builderLen, 0, srcId, idx);
+  vm.addNativeTypeFn<VarStrBuilder>("clear", builderClear, 0, srcId, idx);
+
+  vm.globalAdd("vec", new VarFunc(srcName, ".", {}, {.native = vec}, true,
+                                  srcId, idx));
+  vm.addNativeTypeFn<VarVec>("push", vecPush, 1, srcId, idx);
+  vm.addNativeTypeFn<VarVec>("at", vecAt, 1, srcId, idx);
+  vm.addNativeTypeFn<VarVec>("len", vecLen, 0, srcId, idx);
+  vm.addNativeTypeFn<VarVec>("sum", vecSum, 0, srcId, idx);
+  vm.addNativeTypeFn<VarVec>("min", vecExtreme<false>, 0, srcId, idx);
+  vm.addNativeTypeFn<VarVec>("max", vecExtreme<true>, 0, srcId, idx);
+  vm.addNativeTypeFn<VarVec>("dot", vecDot, 1, srcId, idx);
+  vm.addNativeTypeFn<VarVec>("add", vecMap<kernels::MapAdd>, 1, srcId, idx);
+  vm.addNativeTypeFn<VarVec>("sub", vecMap<kernels::MapSub>, 1, srcId, idx);
+  vm.addNativeTypeFn<VarVec>("mul", vecMap<kernels::MapMul>, 1, srcId, idx);
+  vm.addNativeTypeFn<VarVec>("lt", vecCompare<kernels::CmpLt>, 1, srcId, idx);
+  vm.addNativeTypeFn<VarVec>("le", vecCompare<kernels::CmpLe>, 1, srcId, idx);
+  vm.addNativeTypeFn<VarVec>("gt", vecCompare<kernels::CmpGt>, 1, srcId, idx);
+  vm.addNativeTypeFn<VarVec>("ge", vecCompare<kernels::CmpGe>, 1, srcId, idx);
+  vm.addNativeTypeFn<VarVec>("eq", vecCompare<kernels::CmpEq>, 1, srcId, idx);
+  vm.addNativeTypeFn<VarVec>("ne", vecCompare<kernels::CmpNe>, 1, srcId, idx);
+
+  vm.globalAdd("map", new VarFunc(srcName, ".", {}, {.native = map}, true,
+                                  srcId, idx));
+  vm.addNativeTypeFn<VarMap>("get", mapGet, 1, srcId, idx);
+  vm.addNativeTypeFn<VarMap>("set", mapSet, 2, srcId, idx);
+  vm.addNativeTypeFn<VarMap>("has", mapHas, 1, srcId, idx);
+  vm.addNativeTypeFn<VarMap>("remove", mapRemove, 1, srcId, idx);
+  vm.addNativeTypeFn<VarMap>("len", mapLen, 0, srcId, idx);
+  vm.addNativeTypeFn<VarMap>("keys", mapList<true>, 0, srcId, idx);
+  vm.addNativeTypeFn<VarMap>("values", mapList<false>, 0, srcId, idx);
 
   return true;
 }
@@ -1,24 +1,68 @@
 #include "VM/Consts.hpp"
 #include "VM/OpCodes.hpp"
 
+#include <cstdlib>
+#include <unordered_map>
+
 namespace june {
 namespace constants {
-VarBase *get(State &vm, const OpDataType type, const OpData &opData,
-             const size_t &srcId, const size_t &idx)
+Value get(State &vm, const OpDataType type, const OpData &opData,
+          const size_t &srcId, const size_t &idx)
 {
   switch(type) {
   case OdtBool:
-    return opData.b ? vm.tru : vm.fals;
+    return Value::fromBool(opData.b);
   case OdtNil:
-    return vm.nil;
+    return Value::nil();
   case OdtInt:
-    return make_all<VarInt>(opData.s, srcId, idx);
+    return Value::fromInt(opData.s ? strtoll(opData.s, nullptr, 10) : 0);
   case OdtFloat:
-    return make_all<VarFloat>(opData.s, srcId, idx);
+    return Value::fromFloat(opData.s ? strtod(opData.s, nullptr) : 0.0);
   case OdtString:
-    return make_all<VarString>(opData.s, srcId, idx);
+    return Value::fromVar(
+        make_all<VarString>(StrBuf::intern(opData.s), srcId, idx));
+  case OdtConst:
+    return vm.currentSource()->src()->consts()[opData.sz];
   default:
-    return nullptr;
+    return Value();
+  }
+}
+
+void pool(State &vm, SrcFile *src) {
+  // one entry per distinct literal, keyed by its type and text
+  std::unordered_map<std::string, size_t> known;
+  auto &consts = src->consts();
+  std::vector<Op> &bc = src->bytecode().getMut();
+  const std::vector<OpLoc> &locs = src->bytecode().locs();
+  for (size_t i = 0; i < bc.size(); ++i) {
+    Op &op = bc[i];
+    if (op.op != OpLoad ||
+        (op.type != OdtInt && op.type != OdtFloat && op.type != OdtString))
+      continue;
+
+    std::string key = std::string(1, '0' + op.type) + op.data.s;
+    auto it = known.find(key);
+    size_t loc;
+    if (it != known.end()) {
+      loc = it->second;
+    } else {
+      Value res = get(vm, op.type, op.data, locs[i].srcId, locs[i].idx);
+      if (res.isVar()) {
+        res.asVar()->setConst();
+        valIref(res);
+      }
+      // most names (created variables, members) are loaded as string
+      // constants, interning them up front keeps the vm from doing it
+      if (res.isa<VarString>())
+        AsString(res.asVar())->symbol();
+      loc = consts.size();
+      consts.push_back(res);
+      known[key] = loc;
+    }
+
+    delete[] op.data.s;
+    op.type = OdtConst;
+    op.data.sz = loc;
   }
 }
 }
@@ -1,4 +1,6 @@
 #include <cassert>
+#include <climits>
+#include <cmath>
 #include <cstddef>
 #include <cstdio>
 #include <cstring>
@@ -9,6 +11,7 @@
 #include "VM/Consts.hpp"
 #include "VM/OpCodes.hpp"
 #include "VM/State.hpp"
+#include "VM/Trace.hpp"
 #include "VM/Vars.hpp"
 #include "VM/Vars/Base.hpp"
 #include "c/OpCodes.h"
@@ -16,7 +19,7 @@
 namespace june {
 
 struct JumpData {
-  const char *name;
+  Symbol name; // `symbols::kNone` if the failure isn't stored anywhere
   size_t pos;
 };
 
@@ -35,7 +38,7 @@ char *execFailFmt(const char *fmt, ...) {
 
 #define execFail(failure, ...)                                                 \
   do {                                                                         \
-    handleError(vm, jumps, vars, op, i);                                       \
+    handleError(vm, jumps, vars, loc[i], i);                                   \
     if (!customBytecode)                                                       \
       vars->popFn();                                                           \
     vm.execStackCount--;                                                       \
@@ -43,15 +46,17 @@ char *execFailFmt(const char *fmt, ...) {
   } while (0)
 
 void handleError(State &vm, std::vector<JumpData> &jumps, Vars *vars,
-                 const Op &op, size_t &i) {
+                 const OpLoc &loc, size_t &i) {
   if (!jumps.empty() && !vm.exitCalled) {
     i = jumps.back().pos - 1;
-    if (jumps.back().name) {
+    if (jumps.back().name != symbols::kNone) {
       if (!vm.fails.backEmpty()) {
-        vars->stash(jumps.back().name, vm.fails.pop(false), false);
+        vars->stash(jumps.back().name, Value::fromVar(vm.fails.pop(false)),
+                    false);
       } else {
         vars->stash(jumps.back().name,
-                    make_all<VarString>("Unknown failure", op.srcId, op.idx));
+                    Value::fromVar(make_all<VarString>("Unknown failure",
+                                                       loc.srcId, loc.idx)));
       }
     }
     jumps.pop_back();
@@ -60,6 +65,344 @@ void handleError(State &vm, std::vector<JumpData> &jumps, Vars *vars,
   }
 }
 
+// the name an instruction operates on, interned by `passes::internNames()`
+// unless the bytecode never went through it
+static inline Symbol opName(const Op &op) {
+  return op.type == OdtSymbol ? op.data.sz : symbols::intern(op.data.s);
+}
+
+// the operator an `OpAdd` ... `OpNe` stands for, also the name of the type
+// function it falls back to
+static const char *operatorStr(const OpCodes &op) {
+  static const char *strs[] = {"+", "-", "*", "/",  "%", "<",
+                               "<=", ">", ">=", "==", "!="};
+  return strs[op - OpAdd];
+}
+
+static Symbol operatorName(const OpCodes &op) {
+  static Symbol names[OpNe - OpAdd + 1] = {symbols::kNone};
+  Symbol &name = names[op - OpAdd];
+  if (name == symbols::kNone)
+    name = symbols::intern(operatorStr(op));
+  return name;
+}
+
+// the int in `val`, inline or not
+static inline bool intOf(const Value &val, long long &res) {
+  if (val.isInt()) {
+    res = val.asInt();
+    return true;
+  }
+  if (val.isVar() && val.asVar()->isa<VarInt>()) {
+    res = AsInt(val.asVar())->get();
+    return true;
+  }
+  return false;
+}
+
+// `val` as a float if it's any number
+static inline bool floatOf(const Value &val, double &res) {
+  long long i;
+  if (val.isFloat()) {
+    res = val.asFloat();
+    return true;
+  }
+  if (val.isVar() && val.asVar()->isa<VarFloat>()) {
+    res = AsFloat(val.asVar())->get();
+    return true;
+  }
+  if (intOf(val, i)) {
+    res = (double)i;
+    return true;
+  }
+  return false;
+}
+
+enum ArithRes {
+  ArithOk,
+  ArithNotNumeric,
+  ArithDivByZero,
+  ArithOverflow,
+};
+
+// `OpAdd` ... `OpMod` on two numbers, ints stay ints unless either side is a
+// float
+static ArithRes arith(const OpCodes &op, const Value &lhs, const Value &rhs,
+                      Value &res) {
+  long long li, ri, r = 0;
+  if (intOf(lhs, li) && intOf(rhs, ri)) {
+    bool overflow = false;
+    switch (op) {
+    case OpAdd:
+      overflow = __builtin_add_overflow(li, ri, &r);
+      break;
+    case OpSub:
+      overflow = __builtin_sub_overflow(li, ri, &r);
+      break;
+    case OpMul:
+      overflow = __builtin_mul_overflow(li, ri, &r);
+      break;
+    default:
+      if (ri == 0)
+        return ArithDivByZero;
+      overflow = li == LLONG_MIN && ri == -1;
+      if (!overflow)
+        r = op == OpDiv ? li / ri : li % ri;
+      break;
+    }
+    if (overflow)
+      return ArithOverflow;
+    res = Value::fromInt(r);
+    return ArithOk;
+  }
+
+  double lf, rf;
+  if (!floatOf(lhs, lf) || !floatOf(rhs, rf))
+    return ArithNotNumeric;
+  switch (op) {
+  case OpAdd:
+    res = Value::fromFloat(lf + rf);
+    break;
+  case OpSub:
+    res = Value::fromFloat(lf - rf);
+    break;
+  case OpMul:
+    res = Value::fromFloat(lf * rf);
+    break;
+  case OpDiv:
+    res = Value::fromFloat(lf / rf);
+    break;
+  default:
+    res = Value::fromFloat(std::fmod(lf, rf));
+    break;
+  }
+  return ArithOk;
+}
+
+template <typename T>
+static inline bool compareAs(const OpCodes &op, const T &lhs, const T &rhs) {
+  switch (op) {
+  case OpLt:
+    return lhs < rhs;
+  case OpLe:
+    return lhs <= rhs;
+  case OpGt:
+    return lhs > rhs;
+  case OpGe:
+    return lhs >= rhs;
+  case OpEq:
+    return lhs == rhs;
+  default:
+    return lhs != rhs;
+  }
+}
+
+// `OpLt` ... `OpNe` on two numbers or two strings (and `==`, `!=` on any two
+// inline values), false if they're neither
+static bool compare(const OpCodes &op, const Value &lhs, const Value &rhs,
+                    bool &res) {
+  long long li, ri;
+  double lf, rf;
+  if (intOf(lhs, li) && intOf(rhs, ri))
+    res = compareAs(op, li, ri);
+  else if (floatOf(lhs, lf) && floatOf(rhs, rf))
+    res = compareAs(op, lf, rf);
+  else if (lhs.isa<VarString>() && rhs.isa<VarString>() &&
+           (op == OpEq || op == OpNe))
+    res = AsString(lhs.asVar())->equals(AsString(rhs.asVar())) == (op == OpEq);
+  else if (lhs.isa<VarString>() && rhs.isa<VarString>())
+    res = compareAs(op, AsString(lhs.asVar())->get(),
+                    AsString(rhs.asVar())->get());
+  else if ((op == OpEq || op == OpNe) && lhs.isImmediate() &&
+           rhs.isImmediate())
+    res = (lhs == rhs) == (op == OpEq);
+  else
+    return false;
+  return true;
+}
+
+// `lhs <op> rhs` for `OpAdd` ... `OpNe`, with a reference owned by the caller.
+// Anything but numbers, adding two strings (and strings or inline values for
+// comparisons) is up to the type function named after the operator. On
+// failure, the failure is reported and an undefined value returned, with the
+// message in `err`.
+static Value binaryOp(State &vm, const OpCodes &op, const Value &lhs,
+                      const Value &rhs, TypeFnCache *cache,
+                      std::vector<Value> &args, const OpLoc &loc,
+                      std::string &err) {
+  char msg[128];
+  Value res;
+  if (op == OpAdd && lhs.isa<VarString>() && rhs.isa<VarString>()) {
+    return Value::fromVar(VarString::concat(AsString(lhs.asVar()),
+                                            AsString(rhs.asVar()), loc.srcId,
+                                            loc.idx));
+  }
+  if (op <= OpMod) {
+    ArithRes ar = arith(op, lhs, rhs, res);
+    if (ar == ArithDivByZero || ar == ArithOverflow) {
+      snprintf(msg, sizeof(msg), "%s in '%s'",
+               ar == ArithDivByZero ? "division by zero" : "integer overflow",
+               operatorStr(op));
+      vm.fail(loc.srcId, loc.idx, "%s", msg);
+      err = msg;
+      return Value();
+    }
+  } else {
+    bool cmp;
+    if (compare(op, lhs, rhs, cmp))
+      res = Value::fromBool(cmp);
+  }
+  if (!res.isUndef()) {
+    valIref(res);
+    return res;
+  }
+
+  Symbol name = operatorName(op);
+  Value fn;
+  if (lhs.isAttrBased())
+    fn = lhs.asVar()->attrGet(name);
+  if (fn.isUndef() && cache)
+    fn = Value::fromVar(vm.getTypeFn(lhs, name, *cache));
+  else if (fn.isUndef())
+    fn = Value::fromVar(vm.getTypeFn(lhs, name));
+  if (fn.isUndef() && (op == OpEq || op == OpNe)) {
+    // without an `==` of their own, values are only equal to themselves
+    return Value::fromBool((lhs == rhs) == (op == OpEq));
+  }
+  if (!fn.isCallable()) {
+    err = "type '" + vm.getTypeName(lhs) + "' does not have operator '" +
+          operatorStr(op) + "'";
+    vm.fail(loc.srcId, loc.idx, "%s", err.c_str());
+    return Value();
+  }
+
+  args.clear();
+  args.push_back(lhs);
+  args.push_back(rhs);
+  res = fn.asVar()->call(vm, args, loc.srcId, loc.idx);
+  if (res.isUndef()) {
+    err = std::string("'") + operatorStr(op) + "' call failed, see above";
+    vm.fail(loc.srcId, loc.idx, "%s", err.c_str());
+  }
+  return res;
+}
+
+// `var = var <op> rhs` for the fused slot ops once the inline fast path is
+// out, `slot` being where the variable lives (nullptr for a global `name`).
+// Returns the assigned value with a reference owned by the caller, undefined
+// on failure (with the message in `err`).
+static Value assignOp(State &vm, const OpCodes &op, Value *slot,
+                      const Symbol &name, const Value &rhs,
+                      TypeFnCache *cache, std::vector<Value> &args,
+                      const OpLoc &loc, std::string &err) {
+  Value var = slot ? *slot : Value::fromVar(vm.globalGet(name));
+  if (var.isUndef()) {
+    err = "variable '" + symbols::name(name) + "' does not exist";
+    vm.fail(loc.srcId, loc.idx, "%s", err.c_str());
+    return Value();
+  }
+  Value res = binaryOp(vm, op, var, rhs, cache, args, loc, err);
+  if (res.isUndef())
+    return res;
+  if (var.type() != res.type()) {
+    err = "type mismatch: " + vm.getTypeName(res) +
+          " cannot be assigned to variable of type " + vm.getTypeName(var);
+    valDref(res);
+    vm.fail(loc.srcId, loc.idx, "%s", err.c_str());
+    return Value();
+  }
+
+  if (valReadOnly(var)) {
+    if (slot) {
+      valDref(*slot);
+      *slot = res;
+      valIref(res);
+    }
+    return res;
+  }
+  if (res.isVar()) {
+    var.asVar()->set(res.asVar());
+  } else {
+    VarBase *boxed = vm.box(res, loc.srcId, loc.idx);
+    varIref(boxed);
+    var.asVar()->set(boxed);
+    varDref(boxed);
+  }
+  valDref(res);
+  valIref(var);
+  return var;
+}
+
+// what the name of an `OpLoadSlot` or an `OpLoad` of a symbol refers to,
+// without a reference of its own, undefined if there's nothing by `name`
+static inline Value loadName(State &vm, Vars *vars, VarsStack *locals,
+                             SrcFile *srcFile, const size_t &begin,
+                             const Op &op, Symbol &name) {
+  if (op.type == OdtSize) {
+    Value *slot = locals->slot(op.data.sz);
+    if (slot)
+      return *slot;
+    name = srcFile->localNames(begin)[op.data.sz];
+  } else {
+    name = opName(op);
+  }
+  Value *slot = vars->getRef(name);
+  return slot ? *slot : Value::fromVar(vm.globalGet(name));
+}
+
+#if JuneComputedGoto == true
+// each handler jumps straight to the handler of the next instruction
+#define vmCase(code) Handle##code:
+#define vmNext()                                                               \
+  do {                                                                         \
+    if (++i >= bytecodeSize)                                                   \
+      goto done;                                                               \
+    op = &bc[i];                                                               \
+    goto *dispatch[i];                                                         \
+  } while (0)
+#else
+#define vmCase(code)                                                           \
+  case code:                                                                   \
+  Handle##code:
+#define vmNext() break
+#endif
+// continues with the handler of `code` for instruction `i`, used by
+// superinstructions to get to the last instruction they stand for
+#define vmGoto(code)                                                           \
+  do {                                                                         \
+    op = &bc[i];                                                               \
+    goto Handle##code;                                                         \
+  } while (0)
+
+// ops <src> <exec depth> <index> <op code> <operand type> <stack depth>, the
+// exec depth tells frames apart for utils/op_profile.py
+#define traceOp()                                                              \
+  traceRecord(trace::TraceOps, "%s\t%zu\t%zu\t%s\t%s\t%zu",                    \
+              srcFile->path().c_str(), vm.execStackCount, i,                   \
+              OpCodeStrs[op->op], OpDataTypeStrs[op->type], vms->size())
+
+bool fold(const OpCodes &op, const Value &lhs, const Value &rhs, Value &res) {
+  if (lhs.isUndef() || rhs.isUndef())
+    return false;
+  if (op <= OpMod) {
+    if (arith(op, lhs, rhs, res) != ArithOk)
+      return false;
+    // ints past 48 bits live on the heap (unowned until now), leave those to
+    // the vm
+    if (res.isVar()) {
+      valIref(res);
+      valDref(res);
+      return false;
+    }
+    return true;
+  }
+  bool cmp = false;
+  if (!compare(op, lhs, rhs, cmp))
+    return false;
+  res = Value::fromBool(cmp);
+  return true;
+}
+
 ExecResult exec(State &vm, const Bytecode *customBytecode, const size_t &begin,
                 const size_t &end) {
   vm.execStackCount++;
@@ -69,205 +412,509 @@ ExecResult exec(State &vm, const Bytecode *customBytecode, const size_t &begin,
   SrcFile *srcFile = src->src();
   size_t srcId = srcFile->id();
   Stack *vms = vm.stack;
-  const auto &bc =
-      customBytecode ? customBytecode->get() : srcFile->bytecode().get();
+  const Bytecode &code = customBytecode ? *customBytecode : srcFile->bytecode();
+  const auto &bc = code.get();
+  // only read when something needs a source location
+  const OpLoc *loc = code.locs().data();
   size_t bytecodeSize = end == 0 ? bc.size() : end;
 
   std::vector<FnBodySpan> bodies;
-  std::vector<VarBase *> args;
+  std::vector<Value> args;
   std::vector<JumpData> jumps;
+#if JuneComputedGoto == true
+  const void *const *dispatch;
+#endif
 
   if (!customBytecode)
     vars->pushFn();
+  VarsStack *locals = vars->fnVars();
 
-  for (size_t i = begin; i < bytecodeSize; i++) {
-    const Op &op = bc[i];
-    if (vm.execStackCount >= vm.execStackMax) {
-      vm.fail(bc[i].srcId, bc[i].idx,
-              "exceeded call stack size, currently: %zu", vm.execStackCount);
-      vm.execStackCountExceeded = true;
-      execFail("exceeded call stack size");
-    }
+  size_t i = begin;
+  if (i >= bytecodeSize)
+    goto done;
 
-    if (JuneDebug) {
-      printf("%s [%zu] : %*s: ", srcFile->path().c_str(), i, 12,
-             OpCodeStrs[op.op]);
+  const Op *op;
+  op = &bc[i];
+  // the count only changes when entering or leaving exec, so checking it
+  // once per call is enough
+  if (vm.execStackCount >= vm.execStackMax) {
+    vm.fail(loc[i].srcId, loc[i].idx,
+            "exceeded call stack size, currently: %zu", vm.execStackCount);
+    vm.execStackCountExceeded = true;
+    execFail("exceeded call stack size");
+  }
 
-      for (auto &e : vms->get()) {
-        printf("%s ", vm.getTypeName(e).c_str());
-      }
+#if JuneComputedGoto == true
+  // must list a handler for every op code, in the order of `OpCodes`
+  static const void *const handlers[] = {
+      &&HandleOpCreate,     &&HandleOpStore,       &&HandleOpLoad,
+      &&HandleOpUnload,     &&HandleOpJump,        &&HandleOpJumpTrue,
+      &&HandleOpJumpFalse,  &&HandleOpJumpTruePop, &&HandleOpJumpFalsePop,
+      &&HandleOpJumpNil,    &&HandleOpBodyMarker,  &&HandleOpMakeFunc,
+      &&HandleOpBlkA,       &&HandleOpBlkR,        &&HandleOpCall,
+      &&HandleOpMemberCall, &&HandleOpAttr,        &&HandleOpReturn,
+      &&HandleOpPushLoop,   &&HandleOpPopLoop,     &&HandleOpContinue,
+      &&HandleOpBreak,      &&HandleOpPushJump,    &&HandleOpPushJumpNamed,
+      &&HandleOpPopJump,    &&HandleOpNop,         &&HandleOpLoadSlot,
+      &&HandleOpCreateSlot, &&HandleOpAdd,         &&HandleOpSub,
+      &&HandleOpMul,        &&HandleOpDiv,         &&HandleOpMod,
+      &&HandleOpLt,         &&HandleOpLe,          &&HandleOpGt,
+      &&HandleOpGe,         &&HandleOpEq,          &&HandleOpNe,
+      &&HandleOpIncSlot,    &&HandleOpDecSlot,     &&HandleOpAddSlot,
+      &&HandleOpSubSlot,    &&HandleOpLoadLoadCall,
+      &&HandleOpLoadJumpFalse,
+      &&HandleOpCmpJumpFalse,
+      &&HandleOpCallUnload,
+      &&HandleOpMemberCallUnload,
+  };
+  static_assert(sizeof(handlers) / sizeof(handlers[0]) == _OpLast,
+                "every op code needs a handler");
 
-      printf("\n");
+  {
+    std::vector<const void *> &threaded = code.threaded();
+    if (threaded.size() != bc.size()) {
+      threaded.resize(bc.size());
+      for (size_t pos = 0; pos < bc.size(); ++pos)
+        threaded[pos] = handlers[bc[pos].op];
     }
+    dispatch = threaded.data();
+  }
+#if JuneTrace == true
+  // while tracing, every instruction goes through the tracer first
+  if (trace::enabled(trace::TraceOps)) {
+    std::vector<const void *> &traced = code.traced();
+    if (traced.size() != bc.size())
+      traced.assign(bc.size(), &&HandleTrace);
+    dispatch = traced.data();
+  }
+#endif
+  goto *dispatch[i];
 
-    switch (op.op) {
-    case OpLoad: {
-      if (op.type != OdtIdent) {
-        VarBase *res = constants::get(vm, op.type, op.data, op.srcId, op.idx);
-        if (res == nullptr) {
-          vm.fail(op.srcId, op.idx, "invalid data recieved as a constant");
+#if JuneTrace == true
+HandleTrace:
+  traceOp();
+  goto *handlers[op->op];
+#endif
+#else
+  for (; i < bytecodeSize; ++i) {
+    op = &bc[i];
+    traceOp();
+
+    switch (op->op) {
+#endif
+    vmCase(OpLoadSlot)
+    vmCase(OpLoad) {
+      Symbol name = symbols::kNone;
+      Value *slot = nullptr;
+      if (op->op == OpLoadSlot) {
+        slot = locals->slot(op->data.sz);
+        if (slot == nullptr) {
+          // not created in this function (yet), so the name refers to
+          // whatever it refers to outside of it
+          name = srcFile->localNames(begin)[op->data.sz];
+          slot = vars->getRef(name);
+        }
+      } else if (op->type == OdtConst) {
+        vms->push(srcFile->consts()[op->data.sz]);
+        vmNext();
+      } else if (op->type != OdtSymbol && op->type != OdtIdent) {
+        Value res =
+            constants::get(vm, op->type, op->data, loc[i].srcId, loc[i].idx);
+        if (res.isUndef()) {
+          vm.fail(loc[i].srcId, loc[i].idx,
+                  "invalid data recieved as a constant");
           execFail("invalid data recieved as a constant");
         }
         vms->push(res);
+        vmNext();
       } else {
-        VarBase *res = vars->get(op.data.s);
-        if (res == nullptr) {
-          res = vm.globalGet(op.data.s);
-          if (res == nullptr) {
-            vm.fail(op.srcId, op.idx, "variable '%s' does not exist",
-                    op.data.s);
-            execFail("variable '%s' does not exist", op.data.s);
-          }
+        name = opName(*op);
+        slot = vars->getRef(name);
+      }
+
+      if (slot && i + 1 < bytecodeSize && bc[i + 1].op == OpStore &&
+          valReadOnly(*slot)) {
+        // inline values and constants can't be assigned through what's on
+        // the stack, so assignments to them are done here, on the variable
+        if (vms->empty()) {
+          vm.fail(loc[i].srcId, loc[i].idx,
+                  "vm stack has 0 elements, expected at least 1");
+          execFail("vm stack has 0 elements, expected at least 1");
+        }
+        Value val = vms->pop(false);
+        if (slot->type() != val.type()) {
+          vm.fail(loc[i + 1].srcId, loc[i + 1].idx,
+                  "type mismatch: %s cannot be assigned to variable "
+                  "of type %s",
+                  vm.getTypeName(val).c_str(), vm.getTypeName(*slot).c_str());
+          std::string valType = vm.getTypeName(val);
+          valDref(val);
+          execFail(
+              "type mismatch: %s cannot be assigned to variable of type %s",
+              valType.c_str(), vm.getTypeName(*slot).c_str());
         }
-        vms->push(res, true);
+        valDref(*slot);
+        *slot = val;
+        vms->push(val, true);
+        ++i;
+        vmNext();
       }
-      break;
+
+      Value res = slot ? *slot : Value::fromVar(vm.globalGet(name));
+      if (res.isUndef()) {
+        const char *varName = symbols::name(name).c_str();
+        vm.fail(loc[i].srcId, loc[i].idx, "variable '%s' does not exist",
+                varName);
+        execFail("variable '%s' does not exist", varName);
+      }
+      vms->push(res, true);
+      vmNext();
     }
-    case OpUnload: {
+    vmCase(OpUnload) {
       vms->pop();
-      break;
+      vmNext();
     }
-    case OpCreate: {
-      const std::string name = vms->back()->as<VarString>()->get();
+    vmCase(OpCreate) {
+      Symbol name = AsString(vms->back().asVar())->symbol();
       vms->pop();
-      VarBase *ctx = nullptr;
-      if (op.data.b) {
+      Value ctx;
+      if (op->data.b) {
         ctx = vms->pop(false);
       }
-      VarBase *val = vms->pop(false);
-      if (!ctx) {
-        if (val->isLoadAsRef() || val->refCount() == 1) {
+      Value val = vms->pop(false);
+      if (ctx.isUndef()) {
+        if (!val.isVar()) {
+          vars->add(name, val, false);
+        } else if (val.asVar()->isLoadAsRef() || val.asVar()->refCount() == 1) {
           vars->add(name, val, true);
-          val->unsetLoadAsRef();
+          val.asVar()->unsetLoadAsRef();
         } else {
-          vars->add(name, val->copy(op.srcId, op.idx), false);
+          vars->add(
+              name,
+              Value::fromVar(val.asVar()->copy(loc[i].srcId, loc[i].idx)),
+              false);
         }
-        varDref(val);
-        break;
+        valDref(val);
+        vmNext();
       }
 
-      if (ctx->isAttrBased()) {
-        if (val->isLoadAsRef() || val->refCount() == 1) {
-          ctx->attrSet(name, val, true);
-          val->unsetLoadAsRef();
+      if (ctx.isAttrBased()) {
+        if (!val.isVar()) {
+          ctx.asVar()->attrSet(name, val, false);
+        } else if (val.asVar()->isLoadAsRef() || val.asVar()->refCount() == 1) {
+          ctx.asVar()->attrSet(name, val, true);
+          val.asVar()->unsetLoadAsRef();
         } else {
-          ctx->attrSet(name, val->copy(op.srcId, op.idx), false);
+          ctx.asVar()->attrSet(
+              name,
+              Value::fromVar(val.asVar()->copy(loc[i].srcId, loc[i].idx)),
+              false);
         }
       }
 
-      if (!val->isCallable()) {
-        varDref(ctx);
-        varDref(val);
+      if (!val.isCallable()) {
+        valDref(ctx);
+        valDref(val);
         vm.fail(
-            op.srcId, op.idx,
+            loc[i].srcId, loc[i].idx,
             "only callable values can be added to non-attribute based types");
         execFail(
             "only callable values can be added to non-attribute based types");
       }
 
-      vm.addTypeFn(ctx->isa<VarTypeId>() ? ctx->as<VarTypeId>()->get()
-                                         : ctx->typeFnId(),
-                   name, val, true);
-      varDref(ctx);
-      varDref(val);
-      break;
+      vm.addTypeFn(ctx.isa<VarTypeId>() ? AsTypeId(ctx.asVar())->get()
+                                        : ctx.typeFnId(),
+                   name, val.asVar(), true);
+      valDref(ctx);
+      valDref(val);
+      vmNext();
+    }
+    vmCase(OpCreateSlot) {
+      Value val = vms->pop(false);
+      if (!val.isVar()) {
+        locals->setSlot(op->data.sz, val, false);
+      } else if (val.asVar()->isLoadAsRef() || val.asVar()->refCount() == 1) {
+        locals->setSlot(op->data.sz, val, true);
+        val.asVar()->unsetLoadAsRef();
+      } else {
+        locals->setSlot(
+            op->data.sz,
+            Value::fromVar(val.asVar()->copy(loc[i].srcId, loc[i].idx)),
+            false);
+      }
+      valDref(val);
+      vmNext();
+    }
+    vmCase(OpAdd)
+    vmCase(OpSub)
+    vmCase(OpMul)
+    vmCase(OpDiv)
+    vmCase(OpMod)
+    vmCase(OpLt)
+    vmCase(OpLe)
+    vmCase(OpGt)
+    vmCase(OpGe)
+    vmCase(OpEq)
+    vmCase(OpNe) {
+      if (vms->size() < 2) {
+        vm.fail(loc[i].srcId, loc[i].idx,
+                "vm stack has %zu elements, expected at least 2",
+                vms->size());
+        execFail("vm stack has %zu elements, expected at least 2", vms->size());
+      }
+      Value rhs = vms->pop(false);
+      Value lhs = vms->pop(false);
+      std::string err;
+      Value res = binaryOp(vm, op->op, lhs, rhs,
+                           op->cache ? &code.caches()[op->cache - 1] : nullptr,
+                           args, loc[i], err);
+      valDref(lhs);
+      valDref(rhs);
+      if (res.isUndef())
+        execFail("%s", err.c_str());
+      vms->push(res, false);
+      vmNext();
+    }
+    vmCase(OpIncSlot)
+    vmCase(OpDecSlot)
+    vmCase(OpAddSlot)
+    vmCase(OpSubSlot) {
+      bool pushes = op->op == OpAddSlot || op->op == OpSubSlot;
+      bool add = op->op == OpIncSlot || op->op == OpAddSlot;
+      if (pushes && vms->empty()) {
+        vm.fail(loc[i].srcId, loc[i].idx,
+                "vm stack has 0 elements, expected at least 1");
+        execFail("vm stack has 0 elements, expected at least 1");
+      }
+      Value rhs = pushes ? vms->pop(false) : Value::fromInt(1);
+      Value *slot = locals->slot(op->data.sz);
+
+      // inline numbers are updated where they live
+      if (slot && slot->isInt() && rhs.isInt()) {
+        long long res = add ? slot->asInt() + rhs.asInt()
+                            : slot->asInt() - rhs.asInt();
+        if (Value::fitsInt(res)) {
+          *slot = Value::fromInt(res);
+          if (pushes)
+            vms->push(*slot, false);
+          vmNext();
+        }
+      } else if (slot && slot->isFloat() && (rhs.isFloat() || rhs.isInt())) {
+        double by = rhs.isInt() ? rhs.asInt() : rhs.asFloat();
+        *slot = Value::fromFloat(add ? slot->asFloat() + by
+                                     : slot->asFloat() - by);
+        if (pushes)
+          vms->push(*slot, false);
+        vmNext();
+      }
+
+      // everything else goes the way of `OpLoadSlot`, the operator and
+      // `OpStore` would have
+      Symbol name = symbols::kNone;
+      if (slot == nullptr) {
+        name = srcFile->localNames(begin)[op->data.sz];
+        slot = vars->getRef(name);
+      }
+      std::string err;
+      Value res = assignOp(vm, add ? OpAdd : OpSub, slot, name, rhs,
+                           op->cache ? &code.caches()[op->cache - 1] : nullptr,
+                           args, loc[i], err);
+      valDref(rhs);
+      if (res.isUndef())
+        execFail("%s", err.c_str());
+      if (pushes)
+        vms->push(res, false);
+      else
+        valDref(res);
+      vmNext();
+    }
+    vmCase(OpLoadLoadCall) {
+      Symbol name = symbols::kNone;
+      Value fn = loadName(vm, vars, locals, srcFile, begin, *op, name);
+      if (fn.isUndef()) {
+        const char *varName = symbols::name(name).c_str();
+        vm.fail(loc[i].srcId, loc[i].idx, "variable '%s' does not exist",
+                varName);
+        execFail("variable '%s' does not exist", varName);
+      }
+      vms->push(fn, true);
+      const Op &argOp = bc[++i];
+      Value arg = argOp.type == OdtConst
+                      ? srcFile->consts()[argOp.data.sz]
+                      : loadName(vm, vars, locals, srcFile, begin, argOp, name);
+      if (arg.isUndef()) {
+        const char *varName = symbols::name(name).c_str();
+        vm.fail(loc[i].srcId, loc[i].idx, "variable '%s' does not exist",
+                varName);
+        execFail("variable '%s' does not exist", varName);
+      }
+      vms->push(arg, true);
+      ++i;
+      vmGoto(OpCall);
+    }
+    vmCase(OpLoadJumpFalse) {
+      Symbol name = symbols::kNone;
+      Value val = loadName(vm, vars, locals, srcFile, begin, *op, name);
+      if (val.isUndef()) {
+        const char *varName = symbols::name(name).c_str();
+        vm.fail(loc[i].srcId, loc[i].idx, "variable '%s' does not exist",
+                varName);
+        execFail("variable '%s' does not exist", varName);
+      }
+      ++i;
+      if (val.isBool()) {
+        if (!val.asBool())
+          i = bc[i].data.sz - 1;
+        vmNext();
+      }
+      vms->push(val, true);
+      vmGoto(OpJumpFalsePop);
+    }
+    vmCase(OpCmpJumpFalse) {
+      if (vms->size() < 2) {
+        vm.fail(loc[i].srcId, loc[i].idx,
+                "vm stack has %zu elements, expected at least 2",
+                vms->size());
+        execFail("vm stack has %zu elements, expected at least 2", vms->size());
+      }
+      OpCodes cmp = static_cast<OpCodes>(op->data.sz);
+      Value rhs = vms->pop(false);
+      Value lhs = vms->pop(false);
+      bool res = false;
+      if (compare(cmp, lhs, rhs, res)) {
+        valDref(lhs);
+        valDref(rhs);
+        ++i;
+        if (!res)
+          i = bc[i].data.sz - 1;
+        vmNext();
+      }
+      std::string err;
+      Value val = binaryOp(vm, cmp, lhs, rhs,
+                           op->cache ? &code.caches()[op->cache - 1] : nullptr,
+                           args, loc[i], err);
+      valDref(lhs);
+      valDref(rhs);
+      if (val.isUndef())
+        execFail("%s", err.c_str());
+      vms->push(val, false);
+      ++i;
+      vmGoto(OpJumpFalsePop);
     }
-    case OpStore: {
+    vmCase(OpStore) {
       if (vms->size() < 2) {
-        vm.fail(op.srcId, op.idx,
+        vm.fail(loc[i].srcId, loc[i].idx,
                 "vm stack has %zu elements, expected at least "
                 "2",
                 vms->size());
         execFail("vm stack has %zu elements, expected at least 2", vms->size());
       }
 
-      VarBase *var = vms->pop(false);
-      VarBase *val = vms->pop(false);
-      if (var->type() != val->type()) {
-        varDref(val);
-        varDref(var);
-        vm.fail(op.srcId, op.idx,
+      Value var = vms->pop(false);
+      Value val = vms->pop(false);
+      if (var.type() != val.type()) {
+        vm.fail(loc[i].srcId, loc[i].idx,
                 "type mismatch: %s cannot be assigned to variable "
                 "of type %s",
-                vm.getTypeName(var).c_str(), vm.getTypeName(val).c_str());
+                vm.getTypeName(val).c_str(), vm.getTypeName(var).c_str());
+        std::string varType = vm.getTypeName(var);
+        std::string valType = vm.getTypeName(val);
+        valDref(val);
+        valDref(var);
         execFail("type mismatch: %s cannot be assigned to variable of type %s",
-                 vm.getTypeName(var).c_str(), vm.getTypeName(val).c_str());
+                 valType.c_str(), varType.c_str());
       }
 
-      var->set(val);
+      if (valReadOnly(var)) {
+        // an inline temporary or a constant, nothing to write to, the
+        // assignment still evaluates to the assigned value
+        vms->push(val, false);
+        valDref(var);
+        vmNext();
+      }
+
+      if (val.isVar()) {
+        var.asVar()->set(val.asVar());
+      } else {
+        VarBase *boxed = vm.box(val, loc[i].srcId, loc[i].idx);
+        varIref(boxed);
+        var.asVar()->set(boxed);
+        varDref(boxed);
+      }
       vms->push(var, false);
-      varDref(val);
-      break;
+      valDref(val);
+      vmNext();
     }
-    case OpBlkA: {
-      vars->blkAdd(op.data.sz);
-      break;
+    vmCase(OpBlkA) {
+      vars->blkAdd(op->data.sz);
+      vmNext();
     }
-    case OpBlkR: {
-      vars->blkRem(op.data.sz);
-      break;
+    vmCase(OpBlkR) {
+      vars->blkRem(op->data.sz);
+      vmNext();
     }
-    case OpJump: {
-      i = op.data.sz - 1;
-      break;
+    vmCase(OpJump) {
+      i = op->data.sz - 1;
+      vmNext();
     }
-    case OpJumpTrue:
-    case OpJumpTruePop: {
+    vmCase(OpJumpTrue)
+    vmCase(OpJumpTruePop) {
       assert(!vms->empty());
-      VarBase *var = vms->back();
+      Value var = vms->back();
       bool res = false;
-      if (!var->toBool(vm, res, op.srcId, op.idx)) {
-        vm.fail(op.srcId, op.idx, "cannot convert %s to bool",
+      if (!var.toBool(vm, res, loc[i].srcId, loc[i].idx)) {
+        vm.fail(loc[i].srcId, loc[i].idx, "cannot convert %s to bool",
                 vm.getTypeName(var).c_str());
         vms->pop();
         execFail("cannot convert %s to bool", vm.getTypeName(var).c_str());
       }
       if (res)
-        i = op.data.sz - 1;
-      if (!res || op.op == OpJumpTruePop)
+        i = op->data.sz - 1;
+      if (!res || op->op == OpJumpTruePop)
         vms->pop();
-      break;
+      vmNext();
     }
-    case OpJumpFalse:
-    case OpJumpFalsePop: {
+    vmCase(OpJumpFalse)
+    vmCase(OpJumpFalsePop) {
       assert(!vms->empty());
-      VarBase *var = vms->back();
+      Value var = vms->back();
       bool res = false;
-      if (!var->toBool(vm, res, op.srcId, op.idx)) {
-        vm.fail(op.srcId, op.idx, "cannot convert %s to bool",
+      if (!var.toBool(vm, res, loc[i].srcId, loc[i].idx)) {
+        vm.fail(loc[i].srcId, loc[i].idx, "cannot convert %s to bool",
                 vm.getTypeName(var).c_str());
         vms->pop();
         execFail("cannot convert %s to bool", vm.getTypeName(var).c_str());
       }
       if (!res)
-        i = op.data.sz - 1;
-      if (!res || op.op == OpJumpFalsePop)
+        i = op->data.sz - 1;
+      if (!res || op->op == OpJumpFalsePop)
         vms->pop();
-      break;
+      vmNext();
     }
-    case OpJumpNil: {
-      if (vms->back()->isa<VarNil>()) {
+    vmCase(OpJumpNil) {
+      if (vms->back().isa<VarNil>()) {
         vms->pop();
-        i = op.data.sz - 1;
+        i = op->data.sz - 1;
       }
-      break;
+      vmNext();
     }
-    case OpBodyMarker: {
-      bodies.push_back({i + 1, op.data.sz});
-      i = op.data.sz - 1;
-      break;
+    vmCase(OpBodyMarker) {
+      bodies.push_back({i + 1, op->data.sz,
+                        !customBytecode && srcFile->argsInSlots(i + 1)});
+      i = op->data.sz - 1;
+      vmNext();
     }
-    case OpMakeFunc: {
+    vmCase(OpMakeFunc) {
       std::string varArg;
       std::vector<std::string> args;
-      if (op.data.s[0] == '1') {
-        varArg = vms->back()->as<VarString>()->get();
+      if (arity::flag(op->data.sz)) {
+        varArg = vms->back().asVar()->as<VarString>()->get();
         vms->pop();
       }
 
-      size_t argSz = strlen(op.data.s);
-      for (size_t i = 1; i < argSz; i++) {
-        std::string name = vms->back()->as<VarString>()->get();
+      size_t argc = arity::count(op->data.sz);
+      for (size_t i = 0; i < argc; i++) {
+        std::string name = vms->back().asVar()->as<VarString>()->get();
         vms->pop();
         args.push_back(name);
       }
@@ -276,108 +923,117 @@ ExecResult exec(State &vm, const Bytecode *customBytecode, const size_t &begin,
       bodies.pop_back();
 
       vms->push(new VarFunc(srcFile->path(), varArg, args, FnBody{.june = body},
-                          false, op.srcId, op.idx));
-      break;
+                          false, loc[i].srcId, loc[i].idx));
+      vmNext();
     }
-    case OpMemberCall:
-    case OpCall: {
+    vmCase(OpMemberCallUnload)
+    vmCase(OpCallUnload)
+    vmCase(OpMemberCall)
+    vmCase(OpCall) {
       args.clear();
-      size_t len = strlen(op.data.s);
-      bool memCall = op.op == OpMemberCall;
-      bool vaUnpack = op.data.s[0] == '1';
-      for (size_t i = 1; i < len; i++) {
+      // the first argument is the context (`self`), filled in below
+      args.push_back(Value());
+      size_t argc = arity::count(op->data.sz);
+      bool memCall = op->op == OpMemberCall || op->op == OpMemberCallUnload;
+      bool vaUnpack = arity::flag(op->data.sz);
+      for (size_t i = 0; i < argc; i++) {
         args.push_back(vms->pop(false));
       }
 
-      VarBase *ctxBase = nullptr;
-      VarBase *fnBase = nullptr;
-      VarBase *res = nullptr;
-      std::string fnName;
+      Value ctxBase;
+      Value fnBase;
+      Symbol fnName = symbols::kNone;
+      if (memCall) {
+        fnName = AsString(vms->back().asVar())->symbol();
+        vms->pop();
+      }
       if (vaUnpack) {
-        if (!args.back()->isa<VarVec>()) {
-          vm.fail(args.back()->srcId(), args.back()->idx(),
-                  "cannot unpack non-vector value");
+        if (!args.back().isa<VarVec>()) {
+          vm.fail(loc[i].srcId, loc[i].idx, "cannot unpack non-vector value");
           for (auto &arg : args)
-            varDref(arg);
-          if (!memCall)
-            varDref(fnBase);
+            valDref(arg);
           execFail("cannot unpack non-vector value");
         }
-        VarVec *vec = args.back()->as<VarVec>();
+        Value vec = args.back();
         args.pop_back();
-        for (auto &e : vec->get()) {
-          varIref(e);
-          args.push_back(e);
+        VarVec *elems = AsVec(vec.asVar());
+        for (size_t e = 0; e < elems->size(); ++e) {
+          Value elem = elems->at(e);
+          valIref(elem);
+          args.push_back(elem);
         }
-        varDref(vec);
+        valDref(vec);
       }
 
       if (memCall) {
-        fnName = vms->back()->as<VarString>()->get();
-        vms->pop();
         ctxBase = vms->pop(false);
-        if (ctxBase->isAttrBased())
-          fnBase = ctxBase->attrGet(fnName);
-        if (fnBase == nullptr)
-          fnBase = vm.getTypeFn(ctxBase, fnName);
+        if (ctxBase.isAttrBased())
+          fnBase = ctxBase.asVar()->attrGet(fnName);
+        if (fnBase.isUndef() && op->cache != 0)
+          fnBase = Value::fromVar(
+              vm.getTypeFn(ctxBase, fnName, code.caches()[op->cache - 1]));
+        else if (fnBase.isUndef())
+          fnBase = Value::fromVar(vm.getTypeFn(ctxBase, fnName));
       } else {
         fnBase = vms->pop(false);
       }
 
-      if (!fnBase) {
+      if (fnBase.isUndef()) {
         if (memCall)
-          vm.fail(ctxBase->srcId(), ctxBase->idx(),
-                  "cannot find member '%s' on '%s'", fnName.c_str(),
+          vm.fail(loc[i].srcId, loc[i].idx, "cannot find member '%s' on '%s'",
+                  symbols::name(fnName).c_str(),
                   vm.getTypeName(ctxBase).c_str());
         else
-          vm.fail(fnBase->srcId(), fnBase->idx(), "cannot find function '%s'",
-                  fnBase->as<VarString>()->get().c_str());
-        varDref(ctxBase);
+          vm.fail(loc[i].srcId, loc[i].idx, "cannot find function to call");
+        valDref(ctxBase);
         for (auto &arg : args)
-          varDref(arg);
-        if (!memCall)
-          varDref(fnBase);
-        execFail("cannot find function '%s'",
-                 fnBase->as<VarString>()->get().c_str());
+          valDref(arg);
+        execFail("cannot find function '%s'", symbols::name(fnName).c_str());
       }
 
-      if (!fnBase->isCallable()) {
-        vm.fail(op.srcId, op.idx, "'%s' is not a function or struct definition",
+      if (!fnBase.isCallable()) {
+        vm.fail(loc[i].srcId, loc[i].idx,
+                "'%s' is not a function or struct definition",
                 vm.getTypeName(fnBase).c_str());
-        varDref(ctxBase);
+        std::string fnType = vm.getTypeName(fnBase);
+        valDref(ctxBase);
         for (auto &arg : args)
-          varDref(arg);
+          valDref(arg);
         if (!memCall)
-          varDref(fnBase);
+          valDref(fnBase);
         execFail("'%s' is not a function or struct definition",
-                 vm.getTypeName(fnBase).c_str());
+                 fnType.c_str());
       }
 
-      args.insert(args.begin(), ctxBase);
-      res = fnBase->call(vm, args, op.srcId, op.idx);
+      args[0] = ctxBase;
+      Value res = fnBase.asVar()->call(vm, args, loc[i].srcId, loc[i].idx);
 
-      if (!res) {
+      if (res.isUndef()) {
         // prevent showing the failure if the exec stack is too full
         // or we'll get an enourmous stack trace
         if (!vm.execStackCountExceeded) {
-          vm.fail(op.srcId, op.idx, "'%s' call failed, see above",
+          vm.fail(loc[i].srcId, loc[i].idx, "'%s' call failed, see above",
                   vm.getTypeName(fnBase).c_str());
         }
-        varDref(ctxBase);
+        std::string fnType = vm.getTypeName(fnBase);
         for (auto &arg : args)
-          varDref(arg);
+          valDref(arg);
         if (!memCall)
-          varDref(fnBase);
-        execFail("'%s' call failed, see above", vm.getTypeName(fnBase).c_str());
+          valDref(fnBase);
+        execFail("'%s' call failed, see above", fnType.c_str());
       }
 
-      if (!res->isa<VarNil>()) {
+      if (op->op == OpCallUnload || op->op == OpMemberCallUnload) {
+        // nothing uses the result, neither is the `OpUnload` after it
+        valDref(res);
+        ++i;
+      } else {
         vms->push(res, false);
       }
       for (auto &arg : args)
-        varDref(arg);
+        valDref(arg);
       if (!memCall)
-        varDref(fnBase);
+        valDref(fnBase);
       if (vm.exitCalled) {
         assert(jumps.size() == 0);
         if (!customBytecode)
@@ -385,30 +1041,58 @@ ExecResult exec(State &vm, const Bytecode *customBytecode, const size_t &begin,
         vm.execStackCount--;
         return vm.exitCode;
       }
-      break;
+      vmNext();
     }
-    case OpAttr: {
-      const std::string attr = op.data.s;
-      VarBase *ctxBase = vms->pop(false);
-      VarBase *val = nullptr;
-      if (ctxBase->isAttrBased())
-        val = ctxBase->attrGet(attr);
-      if (val == nullptr)
-        val = vm.getTypeFn(ctxBase, attr);
-      if (val == nullptr) {
-        vm.fail(op.srcId, op.idx, "type '%s' does not have attribute '%s'",
-                vm.getTypeName(ctxBase).c_str(), attr.c_str());
-        varDref(ctxBase);
-        execFail("type '%s' does not have attribute '%s'",
-                 vm.getTypeName(ctxBase).c_str(), attr.c_str());
-      }
-      varDref(ctxBase);
+    vmCase(OpAttr) {
+      Symbol attr = opName(*op);
+      Value ctxBase = vms->pop(false);
+      Value val;
+      if (ctxBase.isAttrBased())
+        val = ctxBase.asVar()->attrGet(attr);
+      if (valReadOnly(val) && i + 1 < bytecodeSize &&
+          bc[i + 1].op == OpStore) {
+        // same as for variables, inline attributes are assigned through
+        // their owner rather than through a copy on the stack
+        Value newVal = vms->pop(false);
+        if (val.type() != newVal.type()) {
+          vm.fail(loc[i + 1].srcId, loc[i + 1].idx,
+                  "type mismatch: %s cannot be assigned to variable "
+                  "of type %s",
+                  vm.getTypeName(newVal).c_str(), vm.getTypeName(val).c_str());
+          std::string valType = vm.getTypeName(newVal);
+          valDref(newVal);
+          valDref(ctxBase);
+          execFail(
+              "type mismatch: %s cannot be assigned to variable of type %s",
+              valType.c_str(), vm.getTypeName(val).c_str());
+        }
+        ctxBase.asVar()->attrSet(attr, newVal, true);
+        vms->push(newVal, false);
+        valDref(ctxBase);
+        ++i;
+        vmNext();
+      }
+      if (val.isUndef() && op->cache != 0)
+        val = Value::fromVar(
+            vm.getTypeFn(ctxBase, attr, code.caches()[op->cache - 1]));
+      else if (val.isUndef())
+        val = Value::fromVar(vm.getTypeFn(ctxBase, attr));
+      if (val.isUndef()) {
+        vm.fail(loc[i].srcId, loc[i].idx,
+                "type '%s' does not have attribute '%s'",
+                vm.getTypeName(ctxBase).c_str(), symbols::name(attr).c_str());
+        std::string ctxType = vm.getTypeName(ctxBase);
+        valDref(ctxBase);
+        execFail("type '%s' does not have attribute '%s'", ctxType.c_str(),
+                 symbols::name(attr).c_str());
+      }
       vms->push(val);
-      break;
+      valDref(ctxBase);
+      vmNext();
     }
-    case OpReturn: {
-      if (!op.data.b) {
-        vms->push(vm.nil);
+    vmCase(OpReturn) {
+      if (!op->data.b) {
+        vms->push(Value::nil());
       }
       assert(jumps.size() == 0);
       if (!customBytecode)
@@ -416,43 +1100,50 @@ ExecResult exec(State &vm, const Bytecode *customBytecode, const size_t &begin,
       vm.execStackCount--;
       return vm.exitCode;
     }
-    case OpPushLoop: {
+    vmCase(OpPushLoop) {
       vars->pushLoop();
-      break;
+      vmNext();
     }
-    case OpPopLoop: {
+    vmCase(OpPopLoop) {
       vars->popLoop();
-      break;
+      vmNext();
     }
-    case OpContinue: {
+    vmCase(OpContinue) {
       vars->loopContinue();
-      i = op.data.sz - 1;
-      break;
+      i = op->data.sz - 1;
+      vmNext();
     }
-    case OpBreak: {
-      i = op.data.sz - 1;
-      break;
+    vmCase(OpBreak) {
+      i = op->data.sz - 1;
+      vmNext();
     }
-    case OpPushJump: {
-      jumps.push_back({nullptr, op.data.sz});
+    vmCase(OpPushJump) {
+      jumps.push_back({symbols::kNone, op->data.sz});
       vm.fails.blka();
-      break;
+      vmNext();
     }
-    case OpPushJumpNamed: {
-      jumps.back().name = op.data.s;
-      break;
+    vmCase(OpPushJumpNamed) {
+      jumps.back().name = opName(*op);
+      vmNext();
     }
-    case OpPopJump: {
+    vmCase(OpPopJump) {
       jumps.pop_back();
       vm.fails.blkr();
-      break;
+      vmNext();
     }
+    vmCase(OpNop) {
+      vmNext();
+    }
+#if JuneComputedGoto == false
     case _OpLast: {
       assert(false);
       break;
     }
     }
   }
+#endif
+
+done:
 
   assert(jumps.size() == 0);
   if (!customBytecode)
@@ -0,0 +1,284 @@
+#include "VM/Kernels.hpp"
+#include "VM/Value.hpp"
+
+#include <algorithm>
+#include <cstring>
+
+namespace june {
+namespace kernels {
+
+// two elements at a time, the width of an SSE2 (or NEON) register
+typedef long long IntLanes __attribute__((vector_size(16)));
+typedef double FloatLanes __attribute__((vector_size(16)));
+static constexpr size_t kLanes = sizeof(IntLanes) / sizeof(long long);
+
+// ints in range are below 2^47 in magnitude, so this many of them add up
+// without overflowing
+static constexpr size_t kSumBlock = 4096;
+
+template <typename V, typename T> static inline V load(const T *from) {
+  V res;
+  memcpy(&res, from, sizeof(res));
+  return res;
+}
+
+template <typename V, typename T> static inline void store(T *to, const V &v) {
+  memcpy(to, &v, sizeof(v));
+}
+
+template <typename T, typename V> static inline T lanesSum(const V &v) {
+  T res = 0;
+  for (size_t k = 0; k < kLanes; ++k)
+    res += v[k];
+  return res;
+}
+
+// `a` where `mask` is set, `b` elsewhere
+template <typename V> static inline V select(const IntLanes &mask, V a, V b) {
+  return (V)((mask & (IntLanes)a) | (~mask & (IntLanes)b));
+}
+
+bool sum(const long long *vals, const size_t &n, long long &res) {
+  res = 0;
+  for (size_t from = 0; from < n; from += kSumBlock) {
+    size_t to = std::min(n, from + kSumBlock);
+    IntLanes acc = {};
+    size_t i = from;
+    for (; i + kLanes <= to; i += kLanes)
+      acc += load<IntLanes>(vals + i);
+    long long part = lanesSum<long long>(acc);
+    for (; i < to; ++i)
+      part += vals[i];
+    if (__builtin_add_overflow(res, part, &res))
+      return false;
+  }
+  return true;
+}
+
+double sum(const double *vals, const size_t &n) {
+  FloatLanes acc = {};
+  size_t i = 0;
+  for (; i + kLanes <= n; i += kLanes)
+    acc += load<FloatLanes>(vals + i);
+  double res = lanesSum<double>(acc);
+  for (; i < n; ++i)
+    res += vals[i];
+  return res;
+}
+
+template <typename T, typename V, bool Max>
+static inline T extreme(const T *vals, const size_t &n) {
+  T res = vals[0];
+  size_t i = 0;
+  if (n >= kLanes) {
+    V acc = load<V>(vals);
+    for (i = kLanes; i + kLanes <= n; i += kLanes) {
+      V v = load<V>(vals + i);
+      acc = select((IntLanes)(Max ? v > acc : v < acc), v, acc);
+    }
+    res = acc[0];
+    for (size_t k = 1; k < kLanes; ++k)
+      res = (Max ? acc[k] > res : acc[k] < res) ? acc[k] : res;
+  }
+  for (; i < n; ++i)
+    res = (Max ? vals[i] > res : vals[i] < res) ? vals[i] : res;
+  return res;
+}
+
+long long min(const long long *vals, const size_t &n) {
+  return extreme<long long, IntLanes, false>(vals, n);
+}
+long long max(const long long *vals, const size_t &n) {
+  return extreme<long long, IntLanes, true>(vals, n);
+}
+double min(const double *vals, const size_t &n) {
+  return extreme<double, FloatLanes, false>(vals, n);
+}
+double max(const double *vals, const size_t &n) {
+  return extreme<double, FloatLanes, true>(vals, n);
+}
+
+bool dot(const long long *lhs, const long long *rhs, const size_t &n,
+         long long &res) {
+  // products of two ints in range easily overflow, so every step is checked
+  res = 0;
+  for (size_t i = 0; i < n; ++i) {
+    long long prod;
+    if (__builtin_mul_overflow(lhs[i], rhs[i], &prod) ||
+        __builtin_add_overflow(res, prod, &res))
+      return false;
+  }
+  return true;
+}
+
+double dot(const double *lhs, const double *rhs, const size_t &n) {
+  FloatLanes acc = {};
+  size_t i = 0;
+  for (; i + kLanes <= n; i += kLanes)
+    acc += load<FloatLanes>(lhs + i) * load<FloatLanes>(rhs + i);
+  double res = lanesSum<double>(acc);
+  for (; i < n; ++i)
+    res += lhs[i] * rhs[i];
+  return res;
+}
+
+template <typename T, typename V>
+static inline void mapLanes(const MapOp &op, const T *lhs, const T *rhs,
+                            const T &scalar, T *out, const size_t &n) {
+  V s = V{} + scalar;
+  size_t i = 0;
+  for (; i + kLanes <= n; i += kLanes) {
+    V l = load<V>(lhs + i);
+    V r = rhs ? load<V>(rhs + i) : s;
+    store(out + i, op == MapAdd ? l + r : l - r);
+  }
+  for (; i < n; ++i) {
+    T r = rhs ? rhs[i] : scalar;
+    out[i] = op == MapAdd ? lhs[i] + r : lhs[i] - r;
+  }
+}
+
+bool map(const MapOp &op, const long long *lhs, const long long *rhs,
+         const long long &scalar, long long *out, const size_t &n) {
+  if (op != MapMul) {
+    mapLanes<long long, IntLanes>(op, lhs, rhs, scalar, out, n);
+    return true;
+  }
+  for (size_t i = 0; i < n; ++i) {
+    if (__builtin_mul_overflow(lhs[i], rhs ? rhs[i] : scalar, &out[i]))
+      return false;
+  }
+  return true;
+}
+
+void map(const MapOp &op, const double *lhs, const double *rhs,
+         const double &scalar, double *out, const size_t &n) {
+  if (op != MapMul) {
+    mapLanes<double, FloatLanes>(op, lhs, rhs, scalar, out, n);
+    return;
+  }
+  FloatLanes s = FloatLanes{} + scalar;
+  size_t i = 0;
+  for (; i + kLanes <= n; i += kLanes)
+    store(out + i, load<FloatLanes>(lhs + i) *
+                       (rhs ? load<FloatLanes>(rhs + i) : s));
+  for (; i < n; ++i)
+    out[i] = lhs[i] * (rhs ? rhs[i] : scalar);
+}
+
+template <CmpOp Op, typename T> static inline bool cmpOne(T l, T r) {
+  switch (Op) {
+  case CmpLt:
+    return l < r;
+  case CmpLe:
+    return l <= r;
+  case CmpGt:
+    return l > r;
+  case CmpGe:
+    return l >= r;
+  case CmpEq:
+    return l == r;
+  default:
+    return l != r;
+  }
+}
+
+// comparing float lanes gives `long` lanes, which GCC doesn't convert
+// implicitly
+template <CmpOp Op, typename V> static inline IntLanes cmpLanes(V l, V r) {
+  switch (Op) {
+  case CmpLt:
+    return (IntLanes)(l < r);
+  case CmpLe:
+    return (IntLanes)(l <= r);
+  case CmpGt:
+    return (IntLanes)(l > r);
+  case CmpGe:
+    return (IntLanes)(l >= r);
+  case CmpEq:
+    return (IntLanes)(l == r);
+  default:
+    return (IntLanes)(l != r);
+  }
+}
+
+template <CmpOp Op, typename T, typename V>
+static void compareAll(const T *lhs, const T *rhs, const T &scalar,
+                       std::uint64_t *out, const size_t &n) {
+  V s = V{} + scalar;
+  for (size_t from = 0; from < n; from += 64) {
+    size_t to = std::min(n, from + 64);
+    std::uint64_t word = 0;
+    size_t i = from;
+    for (; i + kLanes <= to; i += kLanes) {
+      IntLanes m = cmpLanes<Op>(load<V>(lhs + i), rhs ? load<V>(rhs + i) : s);
+      for (size_t k = 0; k < kLanes; ++k)
+        word |= (std::uint64_t)(m[k] & 1) << (i - from + k);
+    }
+    for (; i < to; ++i)
+      word |= (std::uint64_t)cmpOne<Op>(lhs[i], rhs ? rhs[i] : scalar)
+              << (i - from);
+    out[from / 64] = word;
+  }
+}
+
+template <typename T, typename V>
+static void compareAny(const CmpOp &op, const T *lhs, const T *rhs,
+                       const T &scalar, std::uint64_t *out, const size_t &n) {
+  switch (op) {
+  case CmpLt:
+    return compareAll<CmpLt, T, V>(lhs, rhs, scalar, out, n);
+  case CmpLe:
+    return compareAll<CmpLe, T, V>(lhs, rhs, scalar, out, n);
+  case CmpGt:
+    return compareAll<CmpGt, T, V>(lhs, rhs, scalar, out, n);
+  case CmpGe:
+    return compareAll<CmpGe, T, V>(lhs, rhs, scalar, out, n);
+  case CmpEq:
+    return compareAll<CmpEq, T, V>(lhs, rhs, scalar, out, n);
+  default:
+    return compareAll<CmpNe, T, V>(lhs, rhs, scalar, out, n);
+  }
+}
+
+void compare(const CmpOp &op, const long long *lhs, const long long *rhs,
+             const long long &scalar, std::uint64_t *out, const size_t &n) {
+  compareAny<long long, IntLanes>(op, lhs, rhs, scalar, out, n);
+}
+
+void compare(const CmpOp &op, const double *lhs, const double *rhs,
+             const double &scalar, std::uint64_t *out, const size_t &n) {
+  compareAny<double, FloatLanes>(op, lhs, rhs, scalar, out, n);
+}
+
+size_t count(const std::uint64_t *bits, const size_t &n) {
+  size_t res = 0;
+  size_t words = n / 64;
+  for (size_t w = 0; w < words; ++w)
+    res += __builtin_popcountll(bits[w]);
+  if (n % 64)
+    res += __builtin_popcountll(bits[words] & ((1ULL << (n % 64)) - 1));
+  return res;
+}
+
+bool fitInline(const long long *vals, const size_t &n) {
+  IntLanes lo = IntLanes{} + Value::kIntMin, hi = IntLanes{} + Value::kIntMax;
+  IntLanes out = {};
+  size_t i = 0;
+  for (; i + kLanes <= n; i += kLanes) {
+    IntLanes v = load<IntLanes>(vals + i);
+    out |= (IntLanes)(v < lo) | (IntLanes)(v > hi);
+  }
+  for (size_t k = 0; k < kLanes; ++k) {
+    if (out[k])
+      return false;
+  }
+  for (; i < n; ++i) {
+    if (!Value::fitsInt(vals[i]))
+      return false;
+  }
+  return true;
+}
+
+} // namespace kernels
+} // namespace june
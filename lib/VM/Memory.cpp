@@ -1,125 +1,249 @@
 #include "VM/Memory.hpp"
 #include "JuneConfig.hpp"
+#include "VM/Trace.hpp"
 #include "c/Memory.h"
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
 #include <mutex>
-
-static std::mutex MemLock;
+#include <new>
+#include <pthread.h>
+#include <vector>
 
 namespace june {
 namespace mem {
-size_t mult8_roundup(size_t sz) { return (sz > 512) ? sz : (sz + 7) & ~7; }
+size_t mult8_roundup(size_t sz) {
+  return (sz > kMaxSmallSize) ? sz : (sz + 7) & ~7;
+}
 } // namespace mem
 
-#if JuneMemDebug == true
-static size_t totalAlloc = 0;
-static size_t totalAllocNoPool = 0;
-static size_t totalAllocRequested = 0;
-static size_t totalManuallyAlloc = 0;
+// first usable byte of a slab, 16 byte aligned; the blocks after the first
+// are only 8 byte aligned since size classes are multiples of 8
+static constexpr size_t kSlabHeaderSize = (sizeof(MemorySlab) + 15) & ~15;
+
+static inline size_t sizeClass(const size_t &sz) { return (sz - 1) >> 3; }
+
+static inline MemorySlab *slabOf(void *ptr) {
+  return reinterpret_cast<MemorySlab *>(reinterpret_cast<std::uintptr_t>(ptr) &
+                                        ~(kSlabSize - 1));
+}
+
+// trivially destructible, so it needs no TLS guard (which a static lib linked
+// into a shared object can't have); the heap is parked through the registry's
+// pthread key instead
+static thread_local MemoryManager *threadHeap = nullptr;
+
+// Keeps track of every heap that was ever handed to a thread. Heaps are never
+// destroyed since blocks they own may still be alive (and may still be freed
+// remotely) after their thread exits; instead, the heap of an exited thread is
+// parked and adopted by the next thread that needs one. The registry itself is
+// never destroyed either, June objects may still be released during static
+// destruction.
+class MemoryRegistry {
+  std::mutex lock;
+  MemoryManager *heaps;
+  std::vector<MemoryManager *> idle;
+  // parks the heap of an exiting thread
+  pthread_key_t exitKey;
+
+  static void threadExit(void *heap) {
+    threadHeap = nullptr;
+    instance().release(static_cast<MemoryManager *>(heap));
+  }
+
+#if JuneTrace == true
+  static void traceTotal() {
+    MemoryRegistry &reg = instance();
+    size_t totalAlloc = 0, totalAllocNoPool = 0, totalAllocRequested = 0,
+           totalManuallyAlloc = 0;
+    {
+      std::lock_guard<std::mutex> guard(reg.lock);
+      for (MemoryManager *h = reg.heaps; h; h = h->nextHeap) {
+        totalAlloc += h->totalAlloc;
+        totalAllocNoPool += h->totalAllocNoPool;
+        totalAllocRequested += h->totalAllocRequested;
+        totalManuallyAlloc += h->totalManuallyAlloc;
+      }
+    }
+    // mem total <slab bytes> <requested bytes> <requests> <system bytes>
+    traceRecord(trace::TraceMem, "total\t%zu\t%zu\t%zu\t%zu", totalAlloc,
+                totalAllocNoPool, totalAllocRequested, totalManuallyAlloc);
+    trace::flush();
+  }
 #endif
 
-void MemoryManager::allocPool() {
-  u8 *alloc = new u8[kPoolSize];
-#if JuneMemDebug
-  totalAlloc += kPoolSize;
+  MemoryRegistry() : heaps(nullptr) {
+    pthread_key_create(&exitKey, threadExit);
+#if JuneTrace == true
+    std::atexit(traceTotal);
 #endif
-  this->pools.push_back({alloc, alloc});
-}
+  }
 
-MemoryManager::MemoryManager() { allocPool(); }
-MemoryManager::~MemoryManager() {
-  for (auto &c : free_chunks) {
-    if (c.first > kPoolSize) {
-      for (auto &blk : c.second) {
-        delete[] blk;
+public:
+  static MemoryRegistry &instance() {
+    static MemoryRegistry *registry = new MemoryRegistry();
+    return *registry;
+  }
+
+  MemoryManager *acquire() {
+    MemoryManager *heap = nullptr;
+    {
+      std::lock_guard<std::mutex> guard(lock);
+      if (!idle.empty()) {
+        heap = idle.back();
+        idle.pop_back();
+      } else {
+        heap = new MemoryManager();
+        heap->nextHeap = heaps;
+        heaps = heap;
       }
     }
-    c.second.clear();
+    pthread_setspecific(exitKey, heap);
+    return heap;
   }
-  free_chunks.clear();
 
-  for (auto &p : pools)
-    delete[] p.mem;
+  void release(MemoryManager *heap) {
+    std::lock_guard<std::mutex> guard(lock);
+    idle.push_back(heap);
+  }
+};
 
-#if JuneMemDebug == true
-  fprintf(stdout,
-          "Total allocated: %zu bytes, without mempool: %zu, requests: %zu, "
-          "manually allocated: %zu bytes\n",
-          totalAlloc, totalAllocNoPool, totalAllocRequested,
-          totalManuallyAlloc);
+MemoryManager::MemoryManager()
+    : slabs(nullptr), remoteFrees(nullptr), nextHeap(nullptr) {
+  for (size_t i = 0; i < kSizeClasses; ++i) {
+    freeLists[i] = nullptr;
+    carveHead[i] = nullptr;
+    carveEnd[i] = nullptr;
+  }
+#if JuneTrace == true
+  totalAlloc = 0;
+  totalAllocNoPool = 0;
+  totalAllocRequested = 0;
+  totalManuallyAlloc = 0;
 #endif
 }
 
+MemoryManager::~MemoryManager() {
+  while (slabs) {
+    MemorySlab *next = slabs->next;
+    std::free(slabs);
+    slabs = next;
+  }
+}
+
 MemoryManager &MemoryManager::instance() {
-  static MemoryManager mem;
-  return mem;
+  if (threadHeap == nullptr)
+    threadHeap = MemoryRegistry::instance().acquire();
+  return *threadHeap;
+}
+
+void MemoryManager::allocSlab(const size_t &cls) {
+  void *mem = nullptr;
+  if (posix_memalign(&mem, kSlabSize, kSlabSize) != 0)
+    throw std::bad_alloc();
+#if JuneTrace == true
+  totalAlloc += kSlabSize;
+#endif
+  MemorySlab *slab = static_cast<MemorySlab *>(mem);
+  slab->owner = this;
+  slab->next = slabs;
+  slab->blockSize = (cls + 1) << 3;
+  slabs = slab;
+
+  carveHead[cls] = static_cast<u8 *>(mem) + kSlabHeaderSize;
+  carveEnd[cls] = static_cast<u8 *>(mem) + kSlabSize;
+}
+
+void MemoryManager::reclaimRemote() {
+  if (remoteFrees.load(std::memory_order_relaxed) == nullptr)
+    return;
+  MemoryBlock *blk = remoteFrees.exchange(nullptr, std::memory_order_acquire);
+  while (blk) {
+    MemoryBlock *next = blk->next;
+    size_t cls = sizeClass(slabOf(blk)->blockSize);
+    blk->next = freeLists[cls];
+    freeLists[cls] = blk;
+    blk = next;
+  }
+}
+
+void *MemoryManager::allocSlow(const size_t &cls) {
+  const size_t blockSize = (cls + 1) << 3;
+
+  if (carveHead[cls] == nullptr || carveHead[cls] + blockSize > carveEnd[cls]) {
+    reclaimRemote();
+    MemoryBlock *blk = freeLists[cls];
+    if (blk) {
+      freeLists[cls] = blk->next;
+      traceRecord(trace::TraceMem, "alloc\t%zu\treclaimed", blockSize);
+      return blk;
+    }
+    allocSlab(cls);
+    traceRecord(trace::TraceMem, "alloc\t%zu\tslab", blockSize);
+  } else {
+    traceRecord(trace::TraceMem, "alloc\t%zu\tcarve", blockSize);
+  }
+
+  u8 *loc = carveHead[cls];
+  carveHead[cls] += blockSize;
+  return loc;
 }
 
 void *MemoryManager::alloc(size_t sz) {
   if (sz == 0)
     return nullptr;
-  std::lock_guard<std::mutex> lock(MemLock);
 
-#if JuneMemDebug == true
+#if JuneTrace == true
   totalAllocNoPool += sz;
   ++totalAllocRequested;
 #endif
 
-  sz = mem::mult8_roundup(sz);
-
-  if (sz > kPoolSize) {
-#if JuneMemDebug == true
-    fprintf(stdout, "Allocating manually ... %zu bytes\n", sz);
+  if (sz > kMaxSmallSize) {
+#if JuneTrace == true
     totalManuallyAlloc += sz;
 #endif
+    traceRecord(trace::TraceMem, "alloc\t%zu\tsystem", sz);
     return new u8[sz];
   }
 
-  if (free_chunks[sz].size() == 0) {
-    for (auto &p : pools) {
-      size_t free_space = kPoolSize - (p.head - p.mem);
-      if (free_space >= sz) {
-        u8 *loc = p.head;
-        p.head += sz;
-#if JuneMemDebug == true
-        fprintf(stdout, "Allocating from pool ... %zu bytes\n", sz);
-#endif
-        return loc;
-      }
-    }
-    allocPool();
-    auto &p = pools.back();
-    u8 *loc = p.head;
-    p.head += sz;
-#if JuneMemDebug == true
-    fprintf(stdout, "Allocating from NEW pool ... %zu bytes\n", sz);
-#endif
-    return loc;
-  }
+  const size_t cls = sizeClass(sz);
+  MemoryBlock *blk = freeLists[cls];
+  if (blk == nullptr)
+    return allocSlow(cls);
 
-  u8 *loc = free_chunks[sz].front();
-  free_chunks[sz].pop_front();
-#if JuneMemDebug == true
-  fprintf(stdout, "Using previously allocated ... %zu bytes\n", sz);
-#endif
-  return loc;
+  freeLists[cls] = blk->next;
+  traceRecord(trace::TraceMem, "alloc\t%zu\tfreelist", (cls + 1) << 3);
+  return blk;
 }
 
 void MemoryManager::free(void *ptr, size_t sz) {
   if (ptr == nullptr || sz == 0)
     return;
-  std::lock_guard<std::mutex> lock(MemLock);
 
-  if (sz > kPoolSize) {
-#if JuneMemDebug == true
-    fprintf(stdout, "Deleting manually ... %zu bytes\n", sz);
-#endif
+  if (sz > kMaxSmallSize) {
+    traceRecord(trace::TraceMem, "free\t%zu\tsystem", sz);
     delete[](u8 *) ptr;
     return;
   }
-#if JuneMemDebug == true
-  fprintf(stdout, "Giving back to pool ... %zu bytes\n", sz);
-#endif
-  free_chunks[sz].push_front((u8 *)ptr);
+
+  MemoryBlock *blk = static_cast<MemoryBlock *>(ptr);
+  MemoryManager *owner = slabOf(ptr)->owner;
+  if (owner == this) {
+    traceRecord(trace::TraceMem, "free\t%zu\tfreelist", sz);
+    const size_t cls = sizeClass(sz);
+    blk->next = freeLists[cls];
+    freeLists[cls] = blk;
+    return;
+  }
+
+  // owned by another thread: hand it back without taking any lock, the owner
+  // picks it up once it runs out of blocks
+  traceRecord(trace::TraceMem, "free\t%zu\tremote", sz);
+  MemoryBlock *head = owner->remoteFrees.load(std::memory_order_relaxed);
+  do {
+    blk->next = head;
+  } while (!owner->remoteFrees.compare_exchange_weak(
+      head, blk, std::memory_order_release, std::memory_order_relaxed));
 }
 
 } // namespace june
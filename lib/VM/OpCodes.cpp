@@ -1,7 +1,8 @@
 #include "VM/OpCodes.hpp"
 #include "Common.hpp"
-#include "VM/Memory.hpp"
+#include "VM/Symbols.hpp"
 #include "c/OpCodes.h"
+#include <cstring>
 #include <sstream>
 #include <string>
 
@@ -12,18 +13,24 @@ const char *june::OpCodeStrs[_OpLast] = {
     "JumpTrue",   "JumpFalse", "JumpTruePop",   "JumpFalsePop", "JumpNil",
     "BodyMarker", "MakeFunc",  "BlkA",          "BlkR",         "Call",
     "MemberCall", "Attr",      "Return",        "PushLoop",     "PopLoop",
-    "Continue",   "PushJump",  "PushJumpNamed", "PopJump",
+    "Continue",   "Break",     "PushJump",      "PushJumpNamed",
+    "PopJump",    "Nop",       "LoadSlot",      "CreateSlot",   "Add",
+    "Sub",        "Mul",       "Div",           "Mod",          "Lt",
+    "Le",         "Gt",        "Ge",            "Eq",           "Ne",
+    "IncSlot",    "DecSlot",   "AddSlot",       "SubSlot",
+    "LoadLoadCall", "LoadJumpFalse", "CmpJumpFalse", "CallUnload",
+    "MemberCallUnload",
 };
 
 const char *june::OpDataTypeStrs[_OdtLast] = {
-    "Int", "Float", "String", "Ident", "Size", "Bool", "Nil",
+    "Int", "Float", "String", "Ident", "Size", "Bool", "Nil", "Const", "Symbol",
 };
 
-std::string june::opAsString(Op op) {
+std::string june::opAsString(const Op &op, const OpLoc &loc) {
   std::stringstream ss;
 
   // <srcId>:<idx>:<op_code> <data_type> <data>
-  ss << op.srcId << ":" << op.idx << ":" << OpCodeStrs[op.op] << " "
+  ss << loc.srcId << ":" << loc.idx << ":" << OpCodeStrs[op.op] << " "
      << OpDataTypeStrs[op.type] << " ";
 
   switch (op.type) {
@@ -48,6 +55,12 @@ std::string june::opAsString(Op op) {
   case OdtNil:
     ss << "nil";
     break;
+  case OdtConst:
+    ss << "#" << op.data.sz;
+    break;
+  case OdtSymbol:
+    ss << symbols::name(op.data.sz);
+    break;
   default:
     break;
   }
@@ -55,39 +68,52 @@ std::string june::opAsString(Op op) {
   return ss.str();
 }
 
+size_t june::arity::fromString(const char *data) {
+  size_t len = strlen(data);
+  if (len == 0)
+    return encode(0, false);
+  return encode(len - 1, data[0] == '1');
+}
+
 june::Bytecode::~Bytecode() {
-  using namespace june::mem;
-  
+  // operand strings come from `duplicateAsCString` (or the bytecode reader),
+  // both of which use `new[]`, so they're never owned by the memory manager
   for (auto &op : bytecode) {
-    if (op.type != OdtSize && op.type != OdtBool && op.type != OdtNil) {
-      mem::free(op.data.s,
-                      mem::mult8_roundup(strlen(op.data.s) + 1));
+    if (op.type != OdtSize && op.type != OdtBool && op.type != OdtNil &&
+        op.type != OdtConst && op.type != OdtSymbol) {
+      delete[] op.data.s;
     }
   }
 }
 
 void june::Bytecode::add(const size_t &idx, const OpCodes op) {
-  this->bytecode.push_back(Op{0, idx, op, OdtNil, {.s = nullptr}});
+  this->add(Op{op, OdtNil, 0, {.s = nullptr}}, OpLoc{0, idx});
 }
 
 void june::Bytecode::adds(const size_t &idx, const OpCodes op,
                           const OpDataType dtype, const std::string &data) {
-  this->bytecode.push_back(
-      Op{0,
-         idx,
-         op,
-         dtype,
-         {.s = (char *)june::string::duplicateAsCString(data)}});
+  if (dtype == OdtString && arity::takesArity(op)) {
+    this->addsz(idx, op, arity::fromString(data.c_str()));
+    return;
+  }
+  this->add(
+      Op{op, dtype, 0, {.s = (char *)june::string::duplicateAsCString(data)}},
+      OpLoc{0, idx});
 }
 
 void june::Bytecode::addb(const size_t &idx, const OpCodes op,
                           const bool &data) {
-  this->bytecode.push_back(Op{0, idx, op, OdtBool, {.b = data}});
+  this->add(Op{op, OdtBool, 0, {.b = data}}, OpLoc{0, idx});
 }
 
 void june::Bytecode::addsz(const size_t &idx, const OpCodes op,
                            const size_t &data) {
-  this->bytecode.push_back(Op{0, idx, op, OdtSize, {.sz = data}});
+  this->add(Op{op, OdtSize, 0, {.sz = data}}, OpLoc{0, idx});
+}
+
+void june::Bytecode::add(const Op &op, const OpLoc &loc) {
+  this->bytecode.push_back(op);
+  this->opLocs.push_back(loc);
 }
 
 june::OpCodes june::Bytecode::at(const size_t &pos) const {
@@ -100,6 +126,11 @@ void june::Bytecode::updatesz(const size_t &pos, const size_t &value) {
   this->bytecode.at(pos).data.sz = value;
 }
 
+void june::Bytecode::setSrcId(const size_t &srcId) {
+  for (auto &loc : opLocs)
+    loc.srcId = srcId;
+}
+
 // C API
 
 june::OpCodes COpCodeToOpCode(const ::OpCodes op) {
@@ -123,6 +154,8 @@ june::OpCodes COpCodeToOpCode(const ::OpCodes op) {
     opData.s = (char *)june::string::duplicateAsCString(data.s);
     break;
   case june::OdtSize:
+  case june::OdtConst:
+  case june::OdtSymbol:
     opData.sz = data.sz;
     break;
   case june::OdtBool:
@@ -149,6 +182,8 @@ june::OpData COpDataToOpData(const ::OpData &data, const ::OpDataType type) {
     opData.s = (char *)june::string::duplicateAsCString(data.s);
     break;
   case ::OdtSize:
+  case ::OdtConst:
+  case ::OdtSymbol:
     opData.sz = data.sz;
     break;
   case ::OdtBool:
@@ -171,10 +206,10 @@ june::OpDataType COpDataTypeToOpDataType(const ::OpDataType type) {
   return static_cast<june::OpDataType>(type);
 }
 
-::Op *OpToCOp(const june::Op op) {
+::Op *OpToCOp(const june::Op &op, const june::OpLoc &loc) {
   ::Op *op_ = new ::Op;
-  op_->srcId = op.srcId;
-  op_->idx = op.idx;
+  op_->srcId = loc.srcId;
+  op_->idx = loc.idx;
   op_->op = OpCodeToCOpCode(op.op);
   op_->type = OpDataTypeToCOpDataType(op.type);
   op_->data = OpDataToCOpData(op.data, op.type);
@@ -182,9 +217,8 @@ june::OpDataType COpDataTypeToOpDataType(const ::OpDataType type) {
 }
 
 june::Op COpToOp(const ::Op *op) {
-  return june::Op{op->srcId, op->idx, COpCodeToOpCode(op->op),
-                  COpDataTypeToOpDataType(op->type),
-                  COpDataToOpData(op->data, op->type)};
+  return june::Op{COpCodeToOpCode(op->op), COpDataTypeToOpDataType(op->type),
+                  0, COpDataToOpData(op->data, op->type)};
 }
 
 june::Bytecode *BytecodeFromC(const ::BytecodeHandle c_bc) {
@@ -192,7 +226,8 @@ june::Bytecode *BytecodeFromC(const ::BytecodeHandle c_bc) {
 }
 
 extern "C" const char *opAsString(::Op op) {
-  return june::string::duplicateAsCString(june::opAsString(COpToOp(&op)));
+  return june::string::duplicateAsCString(june::opAsString(
+      COpToOp(&op), june::OpLoc{op.srcId, op.idx}));
 }
 
 extern "C" BytecodeHandle BytecodeNew() { return new june::Bytecode(); }
@@ -238,7 +273,8 @@ extern "C" void BytecodeUpdateSize(BytecodeHandle b, const size_t idx,
 extern "C" const ::Op **BytecodeGet(BytecodeHandle b) {
   const ::Op **ops = new const ::Op *[BytecodeFromC(b)->size()];
   for (size_t i = 0; i < BytecodeFromC(b)->size(); i++) {
-    ops[i] = OpToCOp(BytecodeFromC(b)->get()[i]);
+    ops[i] =
+        OpToCOp(BytecodeFromC(b)->get()[i], BytecodeFromC(b)->locs()[i]);
   }
 
   return ops;
@@ -247,7 +283,8 @@ extern "C" const ::Op **BytecodeGet(BytecodeHandle b) {
 extern "C" ::Op **BytecodeGetMut(BytecodeHandle b) {
   ::Op **ops = new ::Op *[BytecodeFromC(b)->size()];
   for (size_t i = 0; i < BytecodeFromC(b)->size(); i++) {
-    ops[i] = OpToCOp(BytecodeFromC(b)->get()[i]);
+    ops[i] =
+        OpToCOp(BytecodeFromC(b)->get()[i], BytecodeFromC(b)->locs()[i]);
   }
 
   return ops;
@@ -19,15 +19,17 @@ int hash(const OpDataType type, const OpData data) {
   }
 }
 
-FileCompatibleBytecode june::compressBytecode(const std::vector<Op> &bytecode) {
+FileCompatibleBytecode june::compressBytecode(const std::vector<Op> &bytecode,
+                                              const std::vector<OpLoc> &locs) {
   std::unordered_map<int, std::pair<OpData, OpDataType>> compressedData;
   FileCompatibleBytecode fcb;
   fcb.bytecode.reserve(bytecode.size());
 
-  for (auto &op : bytecode) {
+  for (size_t i = 0; i < bytecode.size(); ++i) {
+    const Op &op = bytecode[i];
     FileCompatibleOp fco;
-    fco.srcId = op.srcId;
-    fco.idx = op.idx;
+    fco.srcId = locs[i].srcId;
+    fco.idx = locs[i].idx;
     fco.op = op.op;
     fco.type = op.type;
 
@@ -48,7 +50,7 @@ FileCompatibleBytecode june::compressBytecode(const std::vector<Op> &bytecode) {
 
 DecompressResult
 june::decompressBytecode(const FileCompatibleBytecode &bytecode) {
-  std::vector<Op> decompressedBytecode;
+  DecompressedBytecode decompressedBytecode;
   std::unordered_map<int, OpData> compressedData;
 
   for (auto &data : bytecode.compressedData) {
@@ -57,8 +59,7 @@ june::decompressBytecode(const FileCompatibleBytecode &bytecode) {
 
   for (auto &op : bytecode.bytecode) {
     Op opd;
-    opd.srcId = op.srcId;
-    opd.idx = op.idx;
+    opd.cache = 0;
     opd.op = op.op;
     opd.type = op.type;
 
@@ -70,7 +71,14 @@ june::decompressBytecode(const FileCompatibleBytecode &bytecode) {
       opd.data = it->second;
     }
 
-    decompressedBytecode.push_back(opd);
+    if (opd.type == OdtString && arity::takesArity(opd.op)) {
+      // written before arities were stored as sizes
+      opd.type = OdtSize;
+      opd.data.sz = arity::fromString(it->second.s);
+    }
+
+    decompressedBytecode.bytecode.push_back(opd);
+    decompressedBytecode.locs.push_back(OpLoc{op.srcId, op.idx});
   }
 
   return DecompressResult::Ok(decompressedBytecode);
@@ -82,6 +90,7 @@ namespace fs {
 using namespace june::fs;
 
 u8 *writeBytecode(const std::vector<Op> &bytecode,
+                  const std::vector<OpLoc> &locs,
                   const std::vector<SrcColRange> &srcRanges) {
   /**
    * The format of the file
@@ -136,7 +145,7 @@ u8 *writeBytecode(const std::vector<Op> &bytecode,
   size_t dataSize = 0;
   size_t opSize = 0;
 
-  auto compressedBytecode = compressBytecode(bytecode);
+  auto compressedBytecode = compressBytecode(bytecode, locs);
 
   for (auto &d : compressedBytecode.compressedData) {
     dataSize += sizeof(u8);
@@ -408,7 +417,10 @@ ReadResult readBytecode(const u8 *bytecode) {
     return ReadResult::Err(res.unwrapErr());
   }
 
-  return ReadResult::Ok({.bytecode = res.unwrap(), .srcRanges = {}});
+  auto decompressed = res.unwrap();
+  return ReadResult::Ok({.bytecode = decompressed.bytecode,
+                         .locs = decompressed.locs,
+                         .srcRanges = {}});
 }
 
 } // namespace fs
@@ -0,0 +1,656 @@
+#include "VM/Passes.hpp"
+#include "VM/State.hpp"
+#include "VM/Vars/Base.hpp"
+
+#include <unordered_map>
+#include <unordered_set>
+
+namespace june {
+namespace passes {
+
+bool isJump(const OpCodes op) {
+  switch (op) {
+  case OpJump:
+  case OpJumpTrue:
+  case OpJumpFalse:
+  case OpJumpTruePop:
+  case OpJumpFalsePop:
+  case OpJumpNil:
+  case OpBodyMarker:
+  case OpContinue:
+  case OpBreak:
+  case OpPushJump:
+    return true;
+  default:
+    return false;
+  }
+}
+
+const char *PassStrs[_PassLast] = {
+    "locals", "fold", "unload", "dead", "blocks", "jumps", "assign", "fuse",
+};
+
+Pipeline::Pipeline() : before(0), after(0) {
+  for (size_t i = 0; i < _PassLast; ++i) {
+    enabled[i] = true;
+    changes[i] = 0;
+  }
+}
+
+bool Pipeline::disable(const std::string &list) {
+  size_t from = 0;
+  while (from <= list.size()) {
+    size_t to = list.find(',', from);
+    if (to == std::string::npos)
+      to = list.size();
+    std::string name = list.substr(from, to - from);
+    from = to + 1;
+    if (name == "all") {
+      for (size_t i = 0; i < _PassLast; ++i)
+        enabled[i] = false;
+      continue;
+    }
+    size_t pass = 0;
+    while (pass < _PassLast && name != PassStrs[pass])
+      ++pass;
+    if (pass == _PassLast)
+      return false;
+    enabled[pass] = false;
+  }
+  return true;
+}
+
+void Pipeline::dumpStats(std::ostream &os) const {
+  os << "Optimizer: " << before << " instructions before, " << after
+     << " after" << std::endl;
+  for (size_t i = 0; i < _PassLast; ++i) {
+    os << "  " << PassStrs[i] << ": ";
+    if (enabled[i])
+      os << changes[i] << " changes" << std::endl;
+    else
+      os << "off" << std::endl;
+  }
+}
+
+// moves what's keyed by where a function body begins along with the body
+static void moveBodies(SrcFile *src, const std::vector<size_t> &moved) {
+  if (moved.back() + 1 == moved.size())
+    return;
+
+  // local names are keyed by where their function body begins
+  std::unordered_map<size_t, std::vector<Symbol>> names;
+  for (auto &n : src->allLocalNames())
+    names[moved[n.first]] = std::move(n.second);
+  src->allLocalNames() = std::move(names);
+
+  std::unordered_set<size_t> argSlots;
+  for (auto &body : src->allArgSlots())
+    argSlots.insert(moved[body]);
+  src->allArgSlots() = std::move(argSlots);
+}
+
+void run(SrcFile *src, Pipeline &pipeline) {
+  Bytecode &bc = src->bytecode();
+  const bool *enabled = pipeline.enabled;
+  size_t *changes = pipeline.changes;
+  pipeline.before += bc.get().size();
+
+  if (enabled[PassLocals])
+    changes[PassLocals] += resolveLocals(src);
+  internNames(bc);
+  if (enabled[PassFold])
+    changes[PassFold] += foldConstants(src);
+  if (enabled[PassUnload])
+    changes[PassUnload] += dropUnloaded(bc);
+  if (enabled[PassDead])
+    changes[PassDead] += dropDeadCode(bc);
+  if (enabled[PassBlocks])
+    changes[PassBlocks] += dropEmptyBlocks(bc);
+  if (enabled[PassJumps])
+    changes[PassJumps] += threadJumps(bc);
+  moveBodies(src, compact(bc));
+
+  // the instructions of an assignment have to be next to each other
+  if (enabled[PassAssign]) {
+    changes[PassAssign] += fuseAssignments(src);
+    moveBodies(src, compact(bc));
+  }
+
+  assignCaches(bc);
+  if (enabled[PassFuse])
+    changes[PassFuse] += fuseSequences(bc);
+  pipeline.after += bc.get().size();
+}
+
+// positions something jumps to
+static std::unordered_set<size_t> jumpTargets(const std::vector<Op> &bc) {
+  std::unordered_set<size_t> targets;
+  for (auto &op : bc) {
+    if (isJump(op.op))
+      targets.insert(op.data.sz);
+  }
+  return targets;
+}
+
+// whether anything jumps past `from` into the instructions up to `to`
+static bool jumpedInto(const std::unordered_set<size_t> &targets,
+                       const size_t &from, const size_t &to) {
+  for (size_t i = from + 1; i <= to; ++i) {
+    if (targets.count(i) > 0)
+      return true;
+  }
+  return false;
+}
+
+// the closest instruction before `i` that isn't an `OpNop`, `i` if none
+static size_t prevOp(const std::vector<Op> &bc, const size_t &i) {
+  for (size_t j = i; j > 0; --j) {
+    if (bc[j - 1].op != OpNop)
+      return j - 1;
+  }
+  return i;
+}
+
+// the first instruction from `i` on that isn't an `OpNop`
+static size_t nextOp(const std::vector<Op> &bc, size_t i) {
+  while (i < bc.size() && bc[i].op == OpNop)
+    ++i;
+  return i;
+}
+
+// turns `op` into an `OpNop`, freeing the string it may own
+static void drop(Op &op) {
+  if (op.type == OdtInt || op.type == OdtFloat || op.type == OdtString ||
+      op.type == OdtIdent)
+    delete[] op.data.s;
+  op.op = OpNop;
+  op.type = OdtNil;
+  op.data.s = nullptr;
+}
+
+// the name a constant pool string refers to, nullptr for any other value
+static const std::string *constName(SrcFile *src, const Op &op) {
+  if (op.op != OpLoad || op.type != OdtConst)
+    return nullptr;
+  Value &val = src->consts()[op.data.sz];
+  if (!val.isa<VarString>())
+    return nullptr;
+  return &AsString(val.asVar())->get();
+}
+
+static size_t resolveBody(SrcFile *src, const size_t &begin,
+                          const size_t &end,
+                          const std::unordered_set<size_t> &targets,
+                          const std::vector<std::string> *params) {
+  std::vector<Op> &bc = src->bytecode().getMut();
+
+  std::unordered_map<std::string, size_t> creates;
+  for (size_t i = begin; i < end; ++i) {
+    if (bc[i].op == OpBodyMarker) {
+      // nested functions are resolved on their own
+      i = bc[i].data.sz - 1;
+      continue;
+    }
+    if (bc[i].op != OpCreate || bc[i].data.b)
+      continue;
+    const std::string *name = i > begin ? constName(src, bc[i - 1]) : nullptr;
+    // a name that isn't known here could shadow anything
+    if (name == nullptr || targets.count(i) > 0)
+      return 0;
+    ++creates[*name];
+  }
+
+  std::unordered_map<std::string, size_t> slots;
+  std::vector<Symbol> &names = src->localNames(begin);
+  // `self` and the arguments take the first slots unless the body creates a
+  // variable of the same name, they are bound by `VarFunc::call()`
+  bool argSlots = params != nullptr && creates.count("self") == 0;
+  for (size_t i = 0; argSlots && i < params->size(); ++i)
+    argSlots = creates.count((*params)[i]) == 0;
+  if (argSlots) {
+    slots["self"] = names.size();
+    names.push_back(symbols::intern("self"));
+    for (auto &p : *params) {
+      slots[p] = names.size();
+      names.push_back(symbols::intern(p));
+    }
+    src->allArgSlots().insert(begin);
+  }
+  for (auto &c : creates) {
+    // a name created in more than one place may shadow itself in a nested
+    // block, which a single slot can't express
+    if (c.second != 1)
+      continue;
+    slots[c.first] = names.size();
+    names.push_back(symbols::intern(c.first));
+  }
+  if (slots.empty())
+    return 0;
+
+  size_t count = 0;
+  for (size_t i = begin; i < end; ++i) {
+    Op &op = bc[i];
+    if (op.op == OpBodyMarker) {
+      i = op.data.sz - 1;
+      continue;
+    }
+    if (op.op == OpLoad && op.type == OdtIdent) {
+      auto it = slots.find(op.data.s);
+      if (it == slots.end())
+        continue;
+      delete[] op.data.s;
+      op.op = OpLoadSlot;
+      op.type = OdtSize;
+      op.data.sz = it->second;
+      ++count;
+    } else if (op.op == OpCreate && !op.data.b) {
+      auto it = slots.find(*constName(src, bc[i - 1]));
+      if (it == slots.end())
+        continue;
+      bc[i - 1].op = OpNop;
+      bc[i - 1].type = OdtNil;
+      bc[i - 1].data.s = nullptr;
+      op.op = OpCreateSlot;
+      op.type = OdtSize;
+      op.data.sz = it->second;
+      ++count;
+    }
+  }
+  return count;
+}
+
+// Finds the argument names of each function body, in the order
+// `VarFunc::call()` binds them. They're the string constants loaded right
+// before the `OpMakeFunc` that takes the body; bodies whose arguments come
+// from anywhere else are left out.
+static std::unordered_map<size_t, std::vector<std::string>>
+findParams(SrcFile *src) {
+  const std::vector<Op> &bc = src->bytecode().get();
+  std::unordered_map<size_t, std::vector<std::string>> params;
+  std::vector<size_t> bodies;
+  for (size_t i = 0; i < bc.size(); ++i) {
+    if (bc[i].op == OpBodyMarker) {
+      bodies.push_back(i + 1);
+      continue;
+    }
+    if (bc[i].op != OpMakeFunc || bodies.empty())
+      continue;
+    size_t body = bodies.back();
+    bodies.pop_back();
+
+    // the variadic argument's name is on top of the stack
+    size_t first = arity::flag(bc[i].data.sz) ? 1 : 0;
+    size_t argc = arity::count(bc[i].data.sz);
+    if (i < first + argc)
+      continue;
+    std::vector<std::string> names;
+    for (size_t j = 0; j < argc; ++j) {
+      const std::string *name = constName(src, bc[i - 1 - first - j]);
+      if (name == nullptr)
+        break;
+      names.push_back(*name);
+    }
+    if (names.size() == argc)
+      params[body] = std::move(names);
+  }
+  return params;
+}
+
+size_t resolveLocals(SrcFile *src) {
+  const std::vector<Op> &bc = src->bytecode().get();
+  std::unordered_set<size_t> targets = jumpTargets(bc);
+
+  std::unordered_map<size_t, std::vector<std::string>> params =
+      findParams(src);
+  size_t count = 0;
+  for (size_t i = 0; i < bc.size(); ++i) {
+    if (bc[i].op != OpBodyMarker)
+      continue;
+    auto it = params.find(i + 1);
+    count += resolveBody(src, i + 1, bc[i].data.sz, targets,
+                         it == params.end() ? nullptr : &it->second);
+  }
+  return count;
+}
+
+// whether the operand of `op` is a name
+static bool hasName(const Op &op) {
+  switch (op.op) {
+  case OpLoad:
+    return op.type == OdtIdent;
+  case OpAttr:
+  case OpPushJumpNamed:
+    return op.type == OdtIdent || op.type == OdtString;
+  default:
+    return false;
+  }
+}
+
+void internNames(Bytecode &bc) {
+  for (auto &op : bc.getMut()) {
+    if (!hasName(op))
+      continue;
+    Symbol sym = symbols::intern(op.data.s);
+    delete[] op.data.s;
+    op.type = OdtSymbol;
+    op.data.sz = sym;
+  }
+}
+
+// the value a literal load loads, undefined for any other instruction
+static Value literal(SrcFile *src, const Op &op) {
+  if (op.op != OpLoad)
+    return Value();
+  switch (op.type) {
+  case OdtConst:
+    return src->consts()[op.data.sz];
+  case OdtBool:
+    return Value::fromBool(op.data.b);
+  case OdtNil:
+    return Value::nil();
+  default:
+    return Value();
+  }
+}
+
+size_t foldConstants(SrcFile *src) {
+  std::vector<Op> &bc = src->bytecode().getMut();
+  std::vector<Value> &consts = src->consts();
+  std::unordered_set<size_t> targets = jumpTargets(bc);
+
+  size_t count = 0;
+  for (size_t i = 0; i < bc.size(); ++i) {
+    if (bc[i].op < OpAdd || bc[i].op > OpNe)
+      continue;
+    size_t rhs = prevOp(bc, i);
+    size_t lhs = prevOp(bc, rhs);
+    if (lhs == rhs || jumpedInto(targets, lhs, i))
+      continue;
+    Value res;
+    if (!vm::fold(bc[i].op, literal(src, bc[lhs]), literal(src, bc[rhs]),
+                  res))
+      continue;
+
+    Op &op = bc[i];
+    op.op = OpLoad;
+    op.cache = 0;
+    if (res.isBool()) {
+      op.type = OdtBool;
+      op.data.b = res.asBool();
+    } else {
+      // numbers are inline, so an equal constant is the same constant
+      size_t idx = 0;
+      while (idx < consts.size() && consts[idx] != res)
+        ++idx;
+      if (idx == consts.size())
+        consts.push_back(res);
+      op.type = OdtConst;
+      op.data.sz = idx;
+    }
+    drop(bc[lhs]);
+    drop(bc[rhs]);
+    ++count;
+  }
+  return count;
+}
+
+size_t dropUnloaded(Bytecode &bc) {
+  std::vector<Op> &ops = bc.getMut();
+  std::unordered_set<size_t> targets = jumpTargets(ops);
+
+  size_t count = 0;
+  for (size_t i = 0; i < ops.size(); ++i) {
+    if (ops[i].op != OpUnload)
+      continue;
+    size_t load = prevOp(ops, i);
+    if (load == i || ops[load].op != OpLoad ||
+        (ops[load].type != OdtConst && ops[load].type != OdtBool &&
+         ops[load].type != OdtNil) ||
+        jumpedInto(targets, load, i))
+      continue;
+    drop(ops[load]);
+    drop(ops[i]);
+    ++count;
+  }
+  return count;
+}
+
+size_t dropDeadCode(Bytecode &bc) {
+  std::vector<Op> &ops = bc.getMut();
+  std::unordered_set<size_t> targets = jumpTargets(ops);
+
+  size_t count = 0;
+  for (size_t i = 0; i < ops.size(); ++i) {
+    Op &op = ops[i];
+    if (op.op != OpJumpTruePop && op.op != OpJumpFalsePop)
+      continue;
+    size_t load = prevOp(ops, i);
+    if (load == i || ops[load].op != OpLoad || ops[load].type != OdtBool ||
+        jumpedInto(targets, load, i))
+      continue;
+    bool taken = ops[load].data.b == (op.op == OpJumpTruePop);
+    drop(ops[load]);
+    if (taken)
+      op.op = OpJump;
+    else
+      drop(op);
+    ++count;
+  }
+
+  for (size_t i = 0; i < ops.size(); ++i) {
+    OpCodes op = ops[i].op;
+    if (op != OpJump && op != OpReturn && op != OpContinue && op != OpBreak)
+      continue;
+    // function bodies are only ever entered through their marker
+    size_t j = i + 1;
+    for (; j < ops.size() && targets.count(j) == 0; ++j) {
+      if (ops[j].op == OpBodyMarker)
+        break;
+      if (ops[j].op == OpNop)
+        continue;
+      drop(ops[j]);
+      ++count;
+    }
+    i = j - 1;
+  }
+  return count;
+}
+
+size_t dropEmptyBlocks(Bytecode &bc) {
+  std::vector<Op> &ops = bc.getMut();
+  std::unordered_set<size_t> targets = jumpTargets(ops);
+
+  size_t count = 0;
+  for (size_t i = 0; i < ops.size(); ++i) {
+    if (ops[i].op != OpBlkR)
+      continue;
+    size_t add = prevOp(ops, i);
+    if (add == i || ops[add].op != OpBlkA ||
+        ops[add].data.sz != ops[i].data.sz || jumpedInto(targets, add, i))
+      continue;
+    drop(ops[add]);
+    drop(ops[i]);
+    ++count;
+  }
+  return count;
+}
+
+size_t threadJumps(Bytecode &bc) {
+  std::vector<Op> &ops = bc.getMut();
+
+  size_t count = 0;
+  for (size_t i = 0; i < ops.size(); ++i) {
+    Op &op = ops[i];
+    if (op.op < OpJump || op.op > OpJumpNil)
+      continue;
+    // a few hops are plenty, and keep loops of jumps from going on forever
+    size_t to = op.data.sz;
+    for (size_t hops = 0; hops < 8; ++hops) {
+      size_t next = nextOp(ops, to);
+      if (next == ops.size() || ops[next].op != OpJump || next == i)
+        break;
+      to = ops[next].data.sz;
+    }
+    if (to != op.data.sz) {
+      op.data.sz = to;
+      ++count;
+    }
+    if (op.op == OpJump && nextOp(ops, i + 1) == nextOp(ops, to)) {
+      drop(op);
+      ++count;
+    }
+  }
+  return count;
+}
+
+size_t fuseAssignments(SrcFile *src) {
+  std::vector<Op> &bc = src->bytecode().getMut();
+  std::unordered_set<size_t> targets = jumpTargets(bc);
+  size_t count = 0;
+
+  // LoadSlot n, <load>, Add/Sub, LoadSlot n, Store
+  for (size_t i = 0; i + 4 < bc.size(); ++i) {
+    if (bc[i].op != OpLoadSlot || bc[i + 3].op != OpLoadSlot ||
+        bc[i].data.sz != bc[i + 3].data.sz || bc[i + 4].op != OpStore)
+      continue;
+    if (bc[i + 2].op != OpAdd && bc[i + 2].op != OpSub)
+      continue;
+    const Op &rhs = bc[i + 1];
+    if (rhs.op != OpLoad && rhs.op != OpLoadSlot)
+      continue;
+    bool jumpedInto = false;
+    for (size_t j = i + 1; j < i + 5; ++j)
+      jumpedInto = jumpedInto || targets.count(j) > 0;
+    if (jumpedInto)
+      continue;
+
+    // the fused op takes the place of the store, which is where a failed
+    // assignment is reported
+    bool add = bc[i + 2].op == OpAdd;
+    size_t slot = bc[i].data.sz;
+    bool byOne = rhs.op == OpLoad && rhs.type == OdtConst &&
+                 src->consts()[rhs.data.sz] == Value::fromInt(1);
+    size_t last = i + 4;
+    if (byOne && i + 5 < bc.size() && bc[i + 5].op == OpUnload &&
+        targets.count(i + 5) == 0) {
+      // the result isn't used, neither is the loaded 1
+      bc[i + 1].op = OpNop;
+      bc[i + 4].op = add ? OpIncSlot : OpDecSlot;
+      bc[i + 5].op = OpNop;
+      last = i + 5;
+    } else {
+      bc[i + 4].op = add ? OpAddSlot : OpSubSlot;
+    }
+    bc[i + 4].type = OdtSize;
+    bc[i + 4].data.sz = slot;
+    for (size_t j : {i, i + 2, i + 3}) {
+      bc[j].op = OpNop;
+      bc[j].type = OdtNil;
+    }
+    i = last;
+    ++count;
+  }
+  return count;
+}
+
+std::vector<size_t> compact(Bytecode &bc) {
+  std::vector<Op> &ops = bc.getMut();
+  std::vector<OpLoc> &locs = bc.locsMut();
+  std::vector<size_t> moved(ops.size() + 1);
+  size_t pos = 0;
+  for (size_t i = 0; i < ops.size(); ++i) {
+    moved[i] = pos;
+    if (ops[i].op != OpNop)
+      ++pos;
+  }
+  moved[ops.size()] = pos;
+  if (pos == ops.size())
+    return moved;
+
+  pos = 0;
+  for (size_t i = 0; i < ops.size(); ++i) {
+    if (ops[i].op == OpNop)
+      continue;
+    if (isJump(ops[i].op))
+      ops[i].data.sz = moved[ops[i].data.sz];
+    locs[pos] = locs[i];
+    ops[pos++] = ops[i];
+  }
+  ops.resize(pos);
+  locs.resize(pos);
+  return moved;
+}
+
+void assignCaches(Bytecode &bc) {
+  std::vector<Op> &ops = bc.getMut();
+  size_t count = bc.caches().size();
+  for (auto &op : ops) {
+    bool cached = op.op == OpMemberCall || op.op == OpAttr ||
+                  (op.op >= OpAdd && op.op <= OpSubSlot);
+    if (cached && op.cache == 0)
+      op.cache = ++count;
+  }
+  bc.caches().resize(count);
+}
+
+// `OpLoadSlot` or `OpLoad` of an interned name
+static bool isNameLoad(const Op &op) {
+  return op.op == OpLoadSlot || (op.op == OpLoad && op.type == OdtSymbol);
+}
+
+size_t fuseSequences(Bytecode &bc) {
+  std::vector<Op> &ops = bc.getMut();
+  std::unordered_set<size_t> targets = jumpTargets(ops);
+  size_t count = 0;
+  // nothing may jump to an instruction a superinstruction stands for
+  auto fusable = [&](const size_t &from, const size_t &count) {
+    if (from + count > ops.size())
+      return false;
+    for (size_t i = from + 1; i < from + count; ++i) {
+      if (targets.count(i) > 0)
+        return false;
+    }
+    return true;
+  };
+
+  // calls go first so the loads before them can still be fused with them
+  for (size_t i = 0; i + 1 < ops.size(); ++i) {
+    if ((ops[i].op == OpCall || ops[i].op == OpMemberCall) &&
+        ops[i + 1].op == OpUnload && fusable(i, 2)) {
+      ops[i].op = ops[i].op == OpCall ? OpCallUnload : OpMemberCallUnload;
+      ++i;
+      ++count;
+    }
+  }
+
+  for (size_t i = 0; i + 1 < ops.size(); ++i) {
+    Op &op = ops[i];
+    if (op.op >= OpLt && op.op <= OpNe &&
+        ops[i + 1].op == OpJumpFalsePop && fusable(i, 2)) {
+      op.data.sz = op.op;
+      op.type = OdtSize;
+      op.op = OpCmpJumpFalse;
+      ++i;
+      ++count;
+      continue;
+    }
+    if (!isNameLoad(op))
+      continue;
+    if (ops[i + 1].op == OpJumpFalsePop && fusable(i, 2)) {
+      op.op = OpLoadJumpFalse;
+      ++i;
+      ++count;
+    } else if (fusable(i, 3) &&
+               (isNameLoad(ops[i + 1]) ||
+                (ops[i + 1].op == OpLoad && ops[i + 1].type == OdtConst)) &&
+               (ops[i + 2].op == OpCall || ops[i + 2].op == OpCallUnload)) {
+      op.op = OpLoadLoadCall;
+      i += 2;
+      ++count;
+    }
+  }
+  return count;
+}
+
+} // namespace passes
+} // namespace june
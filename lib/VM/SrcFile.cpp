@@ -1,6 +1,7 @@
 #include "VM/SrcFile.hpp"
 #include "Common.hpp"
 #include "VM/OpCodes.hpp"
+#include "VM/Vars/Base.hpp"
 #include "c/OpCodes.h"
 #include "c/SrcFile.h"
 
@@ -19,6 +20,11 @@ SrcFile::SrcFile(const std::string &dir, const std::string &path,
                  const bool isMain)
     : _id(srcId()), _dir(dir), _path(path), _isMain(isMain) {}
 
+SrcFile::~SrcFile() {
+  for (auto &c : _consts)
+    valDref(c);
+}
+
 using namespace err;
 
 Errors SrcFile::loadFile() {
@@ -98,7 +104,7 @@ Errors SrcFile::loadFile() {
     }
 
     auto bytecode = decompressResult.unwrap();
-    addBytecode(bytecode.bytecode);
+    addBytecode(bytecode.bytecode, bytecode.locs);
     addCols(bytecode.srcRanges);
   }
 
@@ -109,10 +115,10 @@ void SrcFile::addData(const std::string &data) { _data += data; }
 
 void SrcFile::addCols(const std::vector<SrcColRange> &cols) { _cols = cols; }
 
-void SrcFile::addBytecode(const std::vector<june::Op> &bytecode) {
-  _bytecode.getMut().resize(bytecode.size());
+void SrcFile::addBytecode(const std::vector<june::Op> &bytecode,
+                          const std::vector<june::OpLoc> &locs) {
   for (size_t i = 0; i < bytecode.size(); i++) {
-    _bytecode.getMut()[i] = bytecode[i];
+    _bytecode.add(bytecode[i], locs[i]);
   }
 }
 
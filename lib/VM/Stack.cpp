@@ -5,24 +5,23 @@ namespace june {
 Stack::Stack() {}
 Stack::~Stack() {
   for (auto &val : _vec) {
-    varDref(val);
+    valDref(val);
   }
 }
 
-void Stack::push(VarBase *val, const bool iref) {
+void Stack::push(const Value &val, const bool iref) {
   if (iref)
-    varIref(val);
+    valIref(val);
   _vec.push_back(val);
 }
 
-VarBase *Stack::pop(const bool dref) {
+Value Stack::pop(const bool dref) {
   if (_vec.size() == 0)
-    return nullptr;
-  VarBase *back = nullptr;
-  back = _vec.back();
+    return Value();
+  Value back = _vec.back();
   _vec.pop_back();
   if (dref)
-    varDref(back);
+    valDref(back);
   return back;
 }
 } // namespace june
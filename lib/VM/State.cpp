@@ -1,6 +1,7 @@
 #include "VM/State.hpp"
 
 #include <algorithm>
+#include <atomic>
 #include <cassert>
 #include <cctype>
 #include <cstdarg>
@@ -10,12 +11,18 @@
 #include <vector>
 
 #include "Common.hpp"
+#include "VM/Consts.hpp"
+#include "VM/Passes.hpp"
 #include "VM/Vars.hpp"
 #include "VM/Vars/Base.hpp"
 #include "json.hpp"
 
 namespace june {
 
+// epochs are handed out process wide so caches filled by one vm are never
+// mistaken as valid by another running the same bytecode
+static std::atomic<size_t> nextTypeFnEpoch(1);
+
 State::State(const std::string &selfBin, const std::string &selfBase,
              const std::vector<std::string> &args)
     : exitCalled(false), execStackCountExceeded(false), exitCode(0),
@@ -23,7 +30,8 @@ State::State(const std::string &selfBin, const std::string &selfBase,
       tru(new VarBool(true, 0, 0)), fals(new VarBool(false, 0, 0)),
       nil(new VarNil(0, 0)), dylib(new Dylib()), stack(new Stack()),
       srcArgs(nullptr), _selfBin(selfBin), _selfBase(selfBase),
-      srcLoadCodeFn(nullptr), srcReadCodeFn(nullptr) {
+      srcLoadCodeFn(nullptr), srcReadCodeFn(nullptr),
+      _typeFnEpoch(nextTypeFnEpoch.fetch_add(1, std::memory_order_relaxed)) {
   initTypenames(*this);
 
   std::vector<VarBase *> srcArgsVec;
@@ -57,17 +65,21 @@ State::~State() {
 }
 
 void State::pushSrc(SrcFile *src, const size_t &idx) {
-  if (allSrcs.find(src->path()) == allSrcs.end()) {
-    allSrcs[src->path()] = new VarSrc(src, new Vars(), src->id(), idx);
+  Symbol path = symbols::intern(src->path());
+  if (allSrcs.find(path) == allSrcs.end()) {
+    allSrcs[path] = new VarSrc(src, new Vars(), src->id(), idx);
+    constants::pool(*this, src);
+    passes::run(src, pipeline);
   }
-  varIref(allSrcs[src->path()]);
-  srcStack.push_back(allSrcs[src->path()]);
+  varIref(allSrcs[path]);
+  srcStack.push_back(allSrcs[path]);
 }
 
-void State::pushSrc(const std::string &srcPath) {
-  assert(allSrcs.find(srcPath) != allSrcs.end());
-  varIref(allSrcs[srcPath]);
-  srcStack.push_back(allSrcs[srcPath]);
+void State::pushSrc(const Symbol &srcPath) {
+  auto it = allSrcs.find(srcPath);
+  assert(it != allSrcs.end());
+  varIref(it->second);
+  srcStack.push_back(it->second);
 }
 
 void State::popSrc() {
@@ -75,7 +87,7 @@ void State::popSrc() {
   srcStack.pop_back();
 }
 
-void State::addTypeFn(const std::uintptr_t &type, const std::string &name,
+void State::addTypeFn(const std::uintptr_t &type, const Symbol &name,
                       VarBase *fn, const bool iref) {
   if (_typeFns.find(type) == _typeFns.end()) {
     _typeFns[type] = new VarsFrame;
@@ -83,33 +95,56 @@ void State::addTypeFn(const std::uintptr_t &type, const std::string &name,
 
   if (_typeFns[type]->exists(name)) {
     this->fail(this->srcStack.back()->srcId(), this->srcStack.back()->idx(),
-               "function '%s' for '%s' already exists", name.c_str(),
+               "function '%s' for '%s' already exists",
+               symbols::name(name).c_str(),
                this->getTypeName(type).c_str());
     return;
   }
 
-  _typeFns[type]->add(name, fn, iref);
+  _typeFns[type]->add(name, Value::fromVar(fn), iref);
+  _typeFnEpoch = nextTypeFnEpoch.fetch_add(1, std::memory_order_relaxed);
 }
 
-VarBase *State::getTypeFn(VarBase *val, const std::string &name) {
-  auto it = _typeFns.find(val->typeFnId());
-  VarBase *res = nullptr;
+VarBase *State::getTypeFn(const Value &val, const Symbol &name) {
+  auto it = _typeFns.find(val.typeFnId());
+  Value res;
   if (it == _typeFns.end()) {
-    if (val->isAttrBased()) {
-      it = _typeFns.find(val->type());
+    if (val.isAttrBased()) {
+      it = _typeFns.find(val.type());
       if (it == _typeFns.end())
-        return _typeFns[type_id<VarAll>()]->get(name);
+        return _typeFns[type_id<VarAll>()]->get(name).asVar();
       res = it->second->get(name);
-      if (res)
-        return res;
-      return _typeFns[type_id<VarAll>()]->get(name);
+      if (!res.isUndef())
+        return res.asVar();
+      return _typeFns[type_id<VarAll>()]->get(name).asVar();
     }
-    return _typeFns[type_id<VarAll>()]->get(name);
+    return _typeFns[type_id<VarAll>()]->get(name).asVar();
   }
   res = it->second->get(name);
-  if (res)
-    return res;
-  return _typeFns[type_id<VarAll>()]->get(name);
+  if (!res.isUndef())
+    return res.asVar();
+  return _typeFns[type_id<VarAll>()]->get(name).asVar();
+}
+
+VarBase *State::getTypeFn(const Value &val, const Symbol &name,
+                          TypeFnCache &cache) {
+  std::uintptr_t typeFnId = val.typeFnId();
+  std::uintptr_t type = val.type();
+  bool attrBased = val.isAttrBased();
+  if (cache.epoch != _typeFnEpoch) {
+    cache.count = 0;
+    cache.epoch = _typeFnEpoch;
+  }
+  for (size_t i = 0; i < cache.count; ++i) {
+    const TypeFnCache::Entry &e = cache.entries[i];
+    if (e.typeFnId == typeFnId && e.type == type && e.attrBased == attrBased)
+      return e.fn;
+  }
+
+  VarBase *fn = getTypeFn(val, name);
+  if (cache.count < TypeFnCache::kEntries)
+    cache.entries[cache.count++] = {typeFnId, type, attrBased, fn};
+  return fn;
 }
 
 void State::setTypeName(const std::uintptr_t &type, const std::string &name) {
@@ -126,7 +161,25 @@ std::string State::getTypeName(const VarBase *val) {
   return this->getTypeName(val->type());
 }
 
-void State::globalAdd(const std::string &name, VarBase *val, const bool iref) {
+std::string State::getTypeName(const Value &val) {
+  return this->getTypeName(val.type());
+}
+
+VarBase *State::box(const Value &val, const size_t &srcId, const size_t &idx) {
+  if (val.isVar())
+    return val.asVar();
+  if (val.isInt())
+    return make_all<VarInt>(val.asInt(), srcId, idx);
+  if (val.isFloat())
+    return make_all<VarFloat>(val.asFloat(), srcId, idx);
+  if (val.isBool())
+    return val.asBool() ? tru : fals;
+  if (val.isNil())
+    return nil;
+  return nullptr;
+}
+
+void State::globalAdd(const Symbol &name, VarBase *val, const bool iref) {
   if (_globals.find(name) != _globals.end())
     return;
   if (iref)
@@ -134,10 +187,11 @@ void State::globalAdd(const std::string &name, VarBase *val, const bool iref) {
   _globals[name] = val;
 }
 
-VarBase *State::globalGet(const std::string &name) {
-  if (_globals.find(name) == _globals.end())
+VarBase *State::globalGet(const Symbol &name) {
+  auto it = _globals.find(name);
+  if (it == _globals.end())
     return nullptr;
-  return _globals[name];
+  return it->second;
 }
 
 // module loading/existance checks
@@ -429,7 +483,7 @@ err::Errors State::juneModuleLoad(std::string &modStr, const size_t &srcId,
                (modStr + juneModuleExt()).c_str());
     return err::Errors::Err(err::Error(err::ErrFileIo, "module not found"));
   }
-  if (allSrcs.find(modStr) != allSrcs.end())
+  if (allSrcs.find(symbols::intern(modStr)) != allSrcs.end())
     return err::Errors::Ok();
 
   auto res = err::Errors::Ok();
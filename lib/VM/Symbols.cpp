@@ -0,0 +1,56 @@
+#include "VM/Symbols.hpp"
+
+#include <deque>
+#include <mutex>
+#include <unordered_map>
+
+namespace june {
+namespace symbols {
+
+// Shared by every thread and never shrinks, names are only interned when code
+// is loaded or when a name is built at runtime, so a single lock is enough.
+class SymbolTable {
+  std::mutex lock;
+  std::unordered_map<std::string, Symbol> ids;
+  // a deque so references to names stay valid as it grows
+  std::deque<std::string> names;
+
+public:
+  SymbolTable() { intern(""); }
+
+  static SymbolTable &instance() {
+    static SymbolTable table;
+    return table;
+  }
+
+  Symbol intern(const std::string &name) {
+    std::lock_guard<std::mutex> guard(lock);
+    auto it = ids.find(name);
+    if (it != ids.end())
+      return it->second;
+    Symbol sym = names.size();
+    names.push_back(name);
+    ids[name] = sym;
+    return sym;
+  }
+
+  const std::string &name(const Symbol &sym) {
+    std::lock_guard<std::mutex> guard(lock);
+    return names[sym];
+  }
+};
+
+Symbol intern(const std::string &name) {
+  return SymbolTable::instance().intern(name);
+}
+
+Symbol intern(const char *name) {
+  return SymbolTable::instance().intern(std::string(name));
+}
+
+const std::string &name(const Symbol &sym) {
+  return SymbolTable::instance().name(sym);
+}
+
+} // namespace symbols
+} // namespace june
@@ -0,0 +1,111 @@
+#include "VM/Trace.hpp"
+
+#if JuneTrace == true
+#include <algorithm>
+#include <cstdarg>
+#include <cstdio>
+#include <cstdlib>
+#include <cstring>
+#include <mutex>
+
+namespace june {
+namespace trace {
+
+unsigned kinds = 0;
+
+static const struct {
+  const char *name;
+  Kind kind;
+} kindNames[] = {
+    {"ops", TraceOps},
+    {"mem", TraceMem},
+};
+
+// The sink is plain static storage so it can still be written to while the
+// memory manager is being torn down, and it never allocates so records can be
+// made from inside the memory manager itself.
+static std::mutex lock;
+static char buffer[64 * 1024];
+static size_t used = 0;
+static FILE *out = nullptr;
+
+static const char *kindName(const Kind &kind) {
+  for (auto &k : kindNames) {
+    if (k.kind == kind)
+      return k.name;
+  }
+  return "?";
+}
+
+static void flushLocked() {
+  if (used > 0 && out)
+    fwrite(buffer, 1, used, out);
+  used = 0;
+  if (out)
+    fflush(out);
+}
+
+bool enable(const std::string &list, const std::string &path) {
+  unsigned wanted = 0;
+  size_t from = 0;
+  while (from <= list.size()) {
+    size_t to = list.find(',', from);
+    if (to == std::string::npos)
+      to = list.size();
+    std::string name = list.substr(from, to - from);
+    from = to + 1;
+    if (name.empty())
+      continue;
+    if (name == "all") {
+      wanted = TraceOps | TraceMem;
+      continue;
+    }
+    bool found = false;
+    for (auto &k : kindNames) {
+      if (name == k.name) {
+        wanted |= k.kind;
+        found = true;
+        break;
+      }
+    }
+    if (!found)
+      return false;
+  }
+
+  std::lock_guard<std::mutex> guard(lock);
+  if (!out) {
+    out = path.empty() ? stderr : fopen(path.c_str(), "w");
+    if (!out)
+      return false;
+    std::atexit(flush);
+  }
+  kinds |= wanted;
+  return true;
+}
+
+void record(const Kind &kind, const char *fmt, ...) {
+  char line[512];
+  int len = snprintf(line, sizeof(line), "%s\t", kindName(kind));
+  va_list args;
+  va_start(args, fmt);
+  int rest = vsnprintf(line + len, sizeof(line) - len - 1, fmt, args);
+  va_end(args);
+  // overlong records are cut short, they still end with a newline
+  len += rest < 0 ? 0 : std::min((size_t)rest, sizeof(line) - len - 2);
+  line[len++] = '\n';
+
+  std::lock_guard<std::mutex> guard(lock);
+  if (used + len > sizeof(buffer))
+    flushLocked();
+  memcpy(buffer + used, line, len);
+  used += len;
+}
+
+void flush() {
+  std::lock_guard<std::mutex> guard(lock);
+  flushLocked();
+}
+
+} // namespace trace
+} // namespace june
+#endif
@@ -8,30 +8,38 @@ namespace june {
 VarsFrame::VarsFrame() {}
 VarsFrame::~VarsFrame() {
   for (auto &var : _vars) {
-    varDref(var.second);
+    valDref(var.second);
   }
 }
 
-VarBase *VarsFrame::get(const std::string &name) {
-  if (_vars.find(name) == _vars.end())
+Value VarsFrame::get(const Symbol &name) {
+  auto it = _vars.find(name);
+  if (it == _vars.end())
+    return Value();
+  return it->second;
+}
+
+Value *VarsFrame::getRef(const Symbol &name) {
+  auto it = _vars.find(name);
+  if (it == _vars.end())
     return nullptr;
-  return _vars[name];
+  return &it->second;
 }
 
-void VarsFrame::add(const std::string &name, VarBase *val, const bool iref) {
+void VarsFrame::add(const Symbol &name, Value val, const bool iref) {
   if (_vars.find(name) != _vars.end()) {
-    varDref(_vars[name]);
+    valDref(_vars[name]);
   }
   if (iref)
-    varIref(val);
+    valIref(val);
   _vars[name] = val;
 }
 
-void VarsFrame::rem(const std::string &name, const bool dref) {
+void VarsFrame::rem(const Symbol &name, const bool dref) {
   if (_vars.find(name) == _vars.end())
     return;
   if (dref)
-    varDref(_vars[name]);
+    valDref(_vars[name]);
   _vars.erase(name);
 }
 
@@ -40,95 +48,146 @@ void VarsFrame::operator delete(void *ptr, size_t sz) { mem::free(ptr, sz); }
 
 // VarsStack
 
-VarsStack::VarsStack() : _top(0) { _stack.push_back(new VarsFrame()); }
-VarsStack::~VarsStack() {
-  for (auto layer = _stack.rbegin(); layer != _stack.rend(); layer++) {
-    delete *layer;
-  }
-}
+VarsStack::VarsStack() { _marks.push_back({0, 0}); }
+VarsStack::~VarsStack() { reset(); }
 
-bool VarsStack::exists(const std::string &name) {
-  return _stack.back()->exists(name);
+void VarsStack::reset() {
+  for (auto var = _vars.rbegin(); var != _vars.rend(); var++) {
+    if (var->name != symbols::kNone)
+      valDref(var->val);
+  }
+  for (auto &s : _created) {
+    valDref(_slots[s]);
+    _slots[s] = Value();
+  }
+  _vars.clear();
+  _created.clear();
+  _loopsFrom.clear();
+  _marks.resize(1);
 }
 
-bool VarsStack::existsGlobal(const std::string &name) {
-  for (auto layer = _stack.rbegin(); layer != _stack.rend(); layer++) {
-    if ((*layer)->exists(name))
+bool VarsStack::exists(const Symbol &name) {
+  for (size_t i = _vars.size(); i > _marks.back().vars; i--) {
+    if (_vars[i - 1].name == name)
       return true;
   }
   return false;
 }
 
-VarBase *VarsStack::get(const std::string &name) {
-  for (auto layer = _stack.rbegin(); layer != _stack.rend(); layer++) {
-    if ((*layer)->exists(name))
-      return (*layer)->get(name);
+bool VarsStack::existsGlobal(const Symbol &name) {
+  return getRef(name) != nullptr;
+}
+
+Value VarsStack::get(const Symbol &name) {
+  Value *res = getRef(name);
+  return res ? *res : Value();
+}
+
+Value *VarsStack::getRef(const Symbol &name) {
+  for (size_t i = _vars.size(); i > 0; i--) {
+    if (_vars[i - 1].name == name)
+      return &_vars[i - 1].val;
   }
   return nullptr;
 }
 
 void VarsStack::incTop(const size_t &count) {
   for (size_t i = 0; i < count; i++) {
-    _stack.push_back(new VarsFrame());
-    _top++;
+    _marks.push_back({_vars.size(), _created.size()});
   }
 }
 
 void VarsStack::decTop(const size_t &count) {
-  if (_top == 0)
-    return;
-  for (size_t i = 0; i < count && _top > 0; i++) {
-    delete _stack.back();
-    _stack.pop_back();
-    _top--;
+  for (size_t i = 0; i < count && top() > 0; i++) {
+    const Mark &mark = _marks.back();
+    while (_vars.size() > mark.vars) {
+      if (_vars.back().name != symbols::kNone)
+        valDref(_vars.back().val);
+      _vars.pop_back();
+    }
+    while (_created.size() > mark.slots) {
+      Value &s = _slots[_created.back()];
+      valDref(s);
+      s = Value();
+      _created.pop_back();
+    }
+    _marks.pop_back();
   }
 }
 
 void VarsStack::pushLoop() {
-  _loopsFrom.push_back(_top + 1);
+  _loopsFrom.push_back(top() + 1);
   incTop(1);
 }
 
 void VarsStack::loopContinue() {
   assert(_loopsFrom.size() > 0);
-  if (_top > _loopsFrom.back()) {
-    decTop(_top - _loopsFrom.back());
+  if (top() > _loopsFrom.back()) {
+    decTop(top() - _loopsFrom.back());
   }
 }
 
 void VarsStack::popLoop() {
   assert(_loopsFrom.size() > 0);
-  if (_top > _loopsFrom.back()) {
-    decTop(_top - _loopsFrom.back());
+  if (top() > _loopsFrom.back()) {
+    decTop(top() - _loopsFrom.back());
   }
 }
 
-void VarsStack::add(const std::string &name, VarBase *val, const bool iref) {
-  _stack.back()->add(name, val, iref);
+void VarsStack::setSlot(const size_t &slot, Value val, const bool iref) {
+  if (slot >= _slots.size())
+    _slots.resize(slot + 1);
+  if (iref)
+    valIref(val);
+  if (_slots[slot].isUndef())
+    _created.push_back(slot);
+  else
+    valDref(_slots[slot]);
+  _slots[slot] = val;
 }
 
-void VarsStack::rem(const std::string &name, const bool dref) {
-  for (auto layer = _stack.rbegin(); layer != _stack.rend(); layer++) {
-    if ((*layer)->exists(name)) {
-      (*layer)->rem(name, dref);
+void VarsStack::add(const Symbol &name, Value val, const bool iref) {
+  if (iref)
+    valIref(val);
+  for (size_t i = _vars.size(); i > _marks.back().vars; i--) {
+    if (_vars[i - 1].name == name) {
+      valDref(_vars[i - 1].val);
+      _vars[i - 1].val = val;
       return;
     }
   }
+  _vars.push_back({name, val});
+}
+
+void VarsStack::rem(const Symbol &name, const bool dref) {
+  for (size_t i = _vars.size(); i > 0; i--) {
+    Entry &var = _vars[i - 1];
+    if (var.name != name)
+      continue;
+    if (dref)
+      valDref(var.val);
+    var.name = symbols::kNone;
+    var.val = Value();
+    return;
+  }
 }
 
 // Vars
 
-Vars::Vars() : _fnStack(-1) { _fnVars[0] = new VarsStack(); }
+Vars::Vars() : _fnStack(-1) {
+  _fnVars.push_back(new VarsStack());
+  _cur = _fnVars[0];
+}
 Vars::~Vars() {
   assert(_fnStack == 0 || _fnStack == -1);
-  delete _fnVars[0];
+  for (auto fn = _fnVars.rbegin(); fn != _fnVars.rend(); fn++) {
+    delete *fn;
+  }
 }
 
-bool Vars::exists(const std::string &name) {
-  return _fnVars[_fnStack]->exists(name);
-}
+bool Vars::exists(const Symbol &name) { return _cur->exists(name); }
 
-bool Vars::existsGlobal(const std::string &name) {
+bool Vars::existsGlobal(const Symbol &name) {
   for (int i = _fnStack; i >= 0; i--) {
     if (_fnVars[i]->existsGlobal(name))
       return true;
@@ -136,62 +195,75 @@ bool Vars::existsGlobal(const std::string &name) {
   return false;
 }
 
-VarBase *Vars::get(const std::string &name) {
+Value Vars::get(const Symbol &name) {
+  Value *res = getRef(name);
+  return res ? *res : Value();
+}
+
+Value *Vars::getRef(const Symbol &name) {
   assert(_fnStack != -1);
-  VarBase *res = _fnVars[_fnStack]->get(name);
+  Value *res = _cur->getRef(name);
   if (res == nullptr && _fnStack != 0) {
-    res = _fnVars[0]->get(name);
+    res = _fnVars[0]->getRef(name);
   }
   return res;
 }
 
 void Vars::blkAdd(const size_t &count) {
-  _fnVars[_fnStack]->incTop(count);
+  _cur->incTop(count);
   for (auto &s : _stash) {
-    _fnVars[_fnStack]->add(s.first, s.second, false);
+    _cur->add(s.first, s.second, false);
   }
   _stash.clear();
 }
 
-void Vars::blkRem(const size_t &count) { _fnVars[_fnStack]->decTop(count); }
+void Vars::blkRem(const size_t &count) { _cur->decTop(count); }
+
+VarsStack *Vars::nextFn() {
+  if (_fnStack + 1 == _fnVars.size())
+    _fnVars.push_back(new VarsStack());
+  return _fnVars[_fnStack + 1];
+}
 
 void Vars::pushFn() {
   ++_fnStack;
   if (_fnStack == 0)
     return;
-  _fnVars[_fnStack] = new VarsStack();
+  if (_fnStack == _fnVars.size())
+    _fnVars.push_back(new VarsStack());
+  _cur = _fnVars[_fnStack];
 }
 
 void Vars::popFn() {
   if (_fnStack == 0)
     return;
-  delete _fnVars[_fnStack];
-  _fnVars.erase(_fnStack);
+  _cur->reset();
   --_fnStack;
+  _cur = _fnVars[_fnStack];
 }
 
-void Vars::stash(const std::string &name, VarBase *val, const bool &iref) {
+void Vars::stash(const Symbol &name, Value val, const bool &iref) {
   if (iref)
-    varIref(val);
+    valIref(val);
   _stash[name] = val;
 }
 
 void Vars::unstash() {
   for (auto &s : _stash)
-    varDref(s.second);
+    valDref(s.second);
   _stash.clear();
 }
 
-void Vars::add(const std::string &name, VarBase *val, const bool &iref) {
-  _fnVars[_fnStack]->add(name, val, iref);
+void Vars::add(const Symbol &name, Value val, const bool &iref) {
+  _cur->add(name, val, iref);
 }
 
-void Vars::addm(const std::string &name, VarBase *val, const bool &iref) {
+void Vars::addm(const Symbol &name, Value val, const bool &iref) {
   _fnVars[0]->add(name, val, iref);
 }
 
-void Vars::rem(const std::string &name, const bool &dref) {
-  _fnVars[_fnStack]->rem(name, dref);
+void Vars::rem(const Symbol &name, const bool &dref) {
+  _cur->rem(name, dref);
 }
 
 } // namespace june
@@ -16,6 +16,8 @@ VarBase::~VarBase() {}
 
 std::uintptr_t VarBase::typeFnId() const { return _type; }
 
+void VarBase::share() { _info |= ViShared; }
+
 bool VarBase::toStr(State &vm, std::string &data, const size_t &srcId,
                     const size_t &idx) {
   if (this->isa<VarString>()) {
@@ -23,11 +25,17 @@ bool VarBase::toStr(State &vm, std::string &data, const size_t &srcId,
     return true;
   }
   
+  static const Symbol toStrSym = symbols::intern("toStr");
   VarBase *strFn = nullptr;
-  if (this->isAttrBased())
-    strFn = this->attrGet("toStr");
-  else
-    strFn = vm.getTypeFn(this, "toStr");
+  if (this->isAttrBased()) {
+    Value attr = this->attrGet(toStrSym);
+    if (attr.isImmediate())
+      // an inline attribute can only be converted, not called
+      return attr.toStr(vm, data, srcId, idx);
+    strFn = attr.asVar();
+  } else {
+    strFn = vm.getTypeFn(this, toStrSym);
+  }
 
   if (!strFn) {
     vm.fail(this->srcId(), this->idx(),
@@ -43,26 +51,26 @@ bool VarBase::toStr(State &vm, std::string &data, const size_t &srcId,
     }
   }
 
-  if (!strFn->call(vm, {this}, srcId, idx)) {
+  Value str = strFn->call(vm, {Value::fromVar(this)}, srcId, idx);
+  if (str.isUndef()) {
     vm.fail(this->srcId(), this->idx(),
             "Unable to convert %s to type `str`: call to `toStr` failed",
             vm.getTypeName(this->type()).c_str());
     return false;
   }
 
-  VarBase *str = vm.stack->pop(false);
-  if (!str->isa<VarString>()) {
+  if (!str.isa<VarString>()) {
     vm.fail(this->srcId(), this->idx(),
             "Unable to convert %s to type `str`: `toStr` returned non-string "
             "(found %s)",
             vm.getTypeName(this->type()).c_str(),
-            vm.getTypeName(str->type()).c_str());
-    varDref(str);
+            vm.getTypeName(str.type()).c_str());
+    valDref(str);
     return false;
   }
 
-  data = str->as<VarString>()->get();
-  varDref(str);
+  data = str.asVar()->as<VarString>()->get();
+  valDref(str);
   return true;
 }
 
@@ -73,11 +81,17 @@ bool VarBase::toBool(State &vm, bool &data, const size_t &srcId,
     return true;
   }
 
+  static const Symbol toBoolSym = symbols::intern("toBool");
   VarBase *boolFn = nullptr;
-  if (this->isAttrBased())
-    boolFn = this->attrGet("toBool");
-  else
-    boolFn = vm.getTypeFn(this, "toBool");
+  if (this->isAttrBased()) {
+    Value attr = this->attrGet(toBoolSym);
+    if (attr.isImmediate())
+      // an inline attribute can only be converted, not called
+      return attr.toBool(vm, data, srcId, idx);
+    boolFn = attr.asVar();
+  } else {
+    boolFn = vm.getTypeFn(this, toBoolSym);
+  }
 
   if (!boolFn) {
     vm.fail(this->srcId(), this->idx(),
@@ -93,51 +107,51 @@ bool VarBase::toBool(State &vm, bool &data, const size_t &srcId,
     }
   }
 
-  if (!boolFn->call(vm, {this}, srcId, idx)) {
+  Value boolVal = boolFn->call(vm, {Value::fromVar(this)}, srcId, idx);
+  if (boolVal.isUndef()) {
     vm.fail(this->srcId(), this->idx(),
             "Unable to convert %s to type `bool`: call to `toBool` failed",
             vm.getTypeName(this->type()).c_str());
     return false;
   }
 
-  VarBase *boolVal = vm.stack->pop(false);
-  if (!boolVal->isa<VarBool>()) {
+  if (!boolVal.isa<VarBool>()) {
     vm.fail(this->srcId(), this->idx(),
             "Unable to convert %s to type `bool`: `toBool` returned non-bool "
             "(found %s)",
             vm.getTypeName(this->type()).c_str(),
-            vm.getTypeName(boolVal->type()).c_str());
-    varDref(boolVal);
+            vm.getTypeName(boolVal.type()).c_str());
+    valDref(boolVal);
     return false;
   }
 
-  data = boolVal->as<VarBool>()->get();
-  varDref(boolVal);
+  data = boolVal.isBool() ? boolVal.asBool()
+                          : boolVal.asVar()->as<VarBool>()->get();
+  valDref(boolVal);
   return true;
 }
 
-VarBase *VarBase::call(State &vm, const std::vector<VarBase *> &args,
-                       const size_t &srcId, const size_t &idx) {
+Value VarBase::call(State &vm, const std::vector<Value> &args,
+                    const size_t &srcId, const size_t &idx) {
   VarBase *applyFn = vm.getTypeFn(this, "apply");
   if (!applyFn) {
     vm.fail(this->srcId(), this->idx(), "%s is not a callable object",
             vm.getTypeName(this->type()).c_str());
-    return nullptr;
+    return Value();
   }
 
-  if (!applyFn->call(vm, args, srcId, idx)) {
+  Value res = applyFn->call(vm, args, srcId, idx);
+  if (res.isUndef()) {
     vm.fail(this->srcId(), this->idx(),
             "Unable to call %s: call to `apply` failed",
             vm.getTypeName(this->type()).c_str());
-    return nullptr;
   }
-
-  return vm.stack->pop(false);
+  return res;
 }
 
-bool VarBase::attrExists(const std::string &attr) const { return false; }
-VarBase *VarBase::attrGet(const std::string &attr) { return nullptr; }
-void VarBase::attrSet(const std::string &attr, VarBase *val, const bool iref) {}
+bool VarBase::attrExists(const Symbol &attr) const { return false; }
+Value VarBase::attrGet(const Symbol &attr) { return Value(); }
+void VarBase::attrSet(const Symbol &attr, Value val, const bool iref) {}
 
 void *VarBase::operator new(size_t size) {
   return mem::alloc(size);
@@ -147,15 +161,61 @@ void VarBase::operator delete(void *ptr, size_t sz) {
   mem::free(ptr, sz);
 }
 
+// Value
+
+bool Value::toStr(State &vm, std::string &data, const size_t &srcId,
+                  const size_t &idx) const {
+  if (isVar())
+    return asVar()->toStr(vm, data, srcId, idx);
+
+  VarBase *boxed = vm.box(*this, srcId, idx);
+  varIref(boxed);
+  bool res = boxed->toStr(vm, data, srcId, idx);
+  varDref(boxed);
+  return res;
+}
+
+bool Value::toBool(State &vm, bool &data, const size_t &srcId,
+                   const size_t &idx) const {
+  if (isBool()) {
+    data = asBool();
+    return true;
+  }
+  if (isVar())
+    return asVar()->toBool(vm, data, srcId, idx);
+
+  VarBase *boxed = vm.box(*this, srcId, idx);
+  varIref(boxed);
+  bool res = boxed->toBool(vm, data, srcId, idx);
+  varDref(boxed);
+  return res;
+}
+
+Value unbox(VarBase *var) {
+  if (var == nullptr)
+    return Value();
+  if (var->isa<VarInt>() && Value::fitsInt(AsInt(var)->get()))
+    return Value::fromInt(AsInt(var)->get());
+  if (var->isa<VarFloat>())
+    return Value::fromFloat(AsFloat(var)->get());
+  if (var->isa<VarBool>())
+    return Value::fromBool(AsBool(var)->get());
+  if (var->isa<VarNil>())
+    return Value::nil();
+  return Value::fromVar(var);
+}
+
 void initTypenames(State &vm) {
   vm.registerType<VarAll>("All");
   vm.registerType<VarBool>("bool");
   vm.registerType<VarFloat>("float");
   vm.registerType<VarFunc>("Func");
   vm.registerType<VarInt>("int");
+  vm.registerType<VarMap>("Map");
   vm.registerType<VarNil>("nil");
   vm.registerType<VarSrc>("Src");
   vm.registerType<VarString>("string");
+  vm.registerType<VarStrBuilder>("StringBuilder");
   vm.registerType<VarVec>("Vec");
 }
 
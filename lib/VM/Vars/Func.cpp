@@ -1,6 +1,8 @@
 #include "VM/State.hpp"
+#include "VM/Vars.hpp"
 #include "VM/Vars/Base.hpp"
-#include <unordered_set>
+#include <algorithm>
+#include <cassert>
 
 namespace june {
 
@@ -8,84 +10,143 @@ VarFunc::VarFunc(const std::string &srcName, const std::string &varArg,
              const std::vector<std::string> &args, const FnBody &body,
              const bool isNative, const size_t &srcId, const size_t &idx)
     : VarBase(type_id<VarFunc>(), srcId, idx, true, false), _srcName(srcName),
-      _args(args), _body(body), _isNative(isNative), _varArg(varArg) {}
+      _args(args), _body(body), _varArg(varArg), _isNative(isNative),
+      _isFixed(false) {
+  _srcSym = symbols::intern(_srcName);
+  for (auto &a : _args)
+    _argSyms.push_back(symbols::intern(a));
+}
+
+VarFunc::VarFunc(const std::string &srcName, const size_t &argsCount,
+                 NativeFixedFnPtr fn, const size_t &srcId, const size_t &idx)
+    : VarBase(type_id<VarFunc>(), srcId, idx, true, false), _srcName(srcName),
+      _args(argsCount, ""), _isNative(true), _isFixed(true) {
+  assert(argsCount <= kMaxFixedArity);
+  _body.fixed = fn;
+  _srcSym = symbols::intern(_srcName);
+  _argSyms.assign(argsCount, symbols::intern(""));
+}
 
 VarBase *VarFunc::copy(const size_t &srcId, const size_t &idx) {
   // should we be able to even copy this?
   // return nullptr;
-  return new VarFunc(_srcName, _varArg, _args, _body, _isNative, srcId,
-                   idx);
+  VarFunc *res = new VarFunc(_srcName, _varArg, _args, _body, _isNative,
+                             srcId, idx);
+  res->_isFixed = _isFixed;
+  return res;
 }
 
 void VarFunc::set(VarBase *from) {
   if (from->isa<VarFunc>()) {
-    _srcName = from->as<VarFunc>()->srcName();
-    _args = from->as<VarFunc>()->args();
+    _srcName = from->as<VarFunc>()->_srcName;
+    _args = from->as<VarFunc>()->_args;
+    _srcSym = from->as<VarFunc>()->_srcSym;
+    _argSyms = from->as<VarFunc>()->_argSyms;
     _body = from->as<VarFunc>()->body();
     _isNative = from->as<VarFunc>()->isNative();
+    _isFixed = from->as<VarFunc>()->_isFixed;
   } else {
     _srcName = "";
     _args.clear();
+    _srcSym = symbols::kNone;
+    _argSyms.clear();
     _body.native = nullptr;
     _isNative = false;
+    _isFixed = false;
   }
 }
 
 bool VarFunc::isNative() const { return _isNative; }
 bool VarFunc::isJune() const { return !_isNative; }
 
-std::string &VarFunc::srcName() { return _srcName; }
+const std::string &VarFunc::srcName() const { return _srcName; }
 std::string &VarFunc::varArg() { return _varArg; }
-std::vector<std::string> &VarFunc::args() { return _args; }
+const std::vector<std::string> &VarFunc::args() const { return _args; }
 FnBody &VarFunc::body() { return _body; }
 
-VarBase *VarFunc::call(State &vm, const std::vector<VarBase *> &args,
-                     const size_t &srcId, const size_t &idx) {
+Value VarFunc::call(State &vm, const std::vector<Value> &args,
+                    const size_t &srcId, const size_t &idx) {
   if (args.size() - 1 < _args.size()) {
     vm.fail(this->srcId(), this->idx(),
             "too few arguments to function: found %zu, expected %zu",
             args.size() - 1, _args.size());
-    return nullptr;
+    return Value();
   } else if (args.size() - 1 > _args.size() && _varArg.empty()) {
     vm.fail(this->srcId(), this->idx(),
             "too many arguments to function: found %zu, expected %zu",
             args.size() - 1, _args.size());
-    return nullptr;
+    return Value();
+  }
+
+  if (_isFixed) {
+    Value res = _body.fixed(vm, NativeArgs{srcId, idx, args.data(),
+                                           args.size()});
+    if (res.isVar()) {
+      if (res.asVar()->refCount() == 0)
+        res.asVar()->setSrcIdAndIdx(this->srcId(), this->idx());
+      varIref(res.asVar());
+    }
+    return res;
   }
 
   if (_isNative) {
-    VarBase *res = _body.native(vm, FnData{srcId, idx, args});
+    // natives only see heap values, inline ones are boxed for the call
+    std::vector<VarBase *> nativeArgs;
+    nativeArgs.reserve(args.size());
+    for (auto &a : args) {
+      VarBase *arg = vm.box(a, srcId, idx);
+      varIref(arg);
+      nativeArgs.push_back(arg);
+    }
+
+    // natives still return a `VarBase *` (nullptr on failure), the result is
+    // unboxed here so the caller gets an inline value where possible
+    VarBase *res = _body.native(vm, FnData{srcId, idx, nativeArgs});
+    if (res != nullptr) {
+      if (res->refCount() == 0)
+        res->setSrcIdAndIdx(this->srcId(), this->idx());
+      varIref(res);
+    }
+    for (auto &arg : nativeArgs)
+      varDref(arg);
     if (res == nullptr)
-      return nullptr;
-    if (res->refCount() == 0)
-      res->setSrcIdAndIdx(this->srcId(), this->idx());
-    vm.stack->push(res);
-    return vm.nil;
-  }
+      return Value();
 
-  vm.pushSrc(_srcName);
-  Vars *vars = vm.currentSource()->vars();
-  if (args[0] != nullptr) {
-    vars->stash("self", args[0]);
+    Value val = unbox(res);
+    if (!val.isVar())
+      varDref(res);
+    return val;
   }
 
-  std::unordered_set<std::string> foundArgs;
-  size_t i = 1;
-  for (auto &a : _args) {
-    if (i == args.size())
-      break;
-    vars->stash(a, args[i++]);
-    foundArgs.insert(a);
+  static const Symbol self = symbols::intern("self");
+
+  vm.pushSrc(_srcSym);
+  // bind straight into the frame the body will run in
+  VarsStack *frame = vm.currentSource()->vars()->nextFn();
+  size_t argc = std::min(args.size(), _argSyms.size() + 1);
+  if (_body.june.argSlots) {
+    for (size_t i = 0; i < argc; ++i) {
+      if (!args[i].isUndef())
+        frame->setSlot(i, args[i], true);
+    }
+  } else {
+    if (!args[0].isUndef())
+      frame->add(self, args[0], true);
+    for (size_t i = 1; i < argc; ++i)
+      frame->add(_argSyms[i - 1], args[i], true);
   }
 
+  // the body leaves its result on the stack (see `OpReturn`)
+  size_t stackSize = vm.stack->size();
   if (vm::exec(vm, nullptr, _body.june.begin, _body.june.end).isErr()) {
-    vars->unstash();
     vm.popSrc();
-    return nullptr;
+    return Value();
   }
 
   vm.popSrc();
-  return vm.nil;
+  if (vm.stack->size() == stackSize)
+    return Value::nil();
+  return vm.stack->pop(false);
 }
 
 } // namespace june
@@ -0,0 +1,285 @@
+#include "VM/State.hpp"
+#include "VM/Vars/Base.hpp"
+
+#include <cstring>
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#endif
+
+namespace june {
+
+// slots probed at once, there is always a multiple of this many
+static constexpr size_t kMapGroup = 16;
+static constexpr std::uint8_t kCtrlEmpty = 0x80;
+static constexpr std::uint8_t kCtrlRemoved = 0xFE;
+
+// bit `i` is set for every control byte in the group at `ctrl` equal to `c`
+static inline unsigned matchCtrl(const std::uint8_t *ctrl,
+                                 const std::uint8_t &c) {
+#if defined(__SSE2__)
+  __m128i group = _mm_loadu_si128(reinterpret_cast<const __m128i *>(ctrl));
+  return _mm_movemask_epi8(_mm_cmpeq_epi8(group, _mm_set1_epi8((char)c)));
+#else
+  unsigned res = 0;
+  for (size_t i = 0; i < kMapGroup; ++i)
+    res |= (unsigned)(ctrl[i] == c) << i;
+  return res;
+#endif
+}
+
+// the low bits of a hash go into the control byte, the rest pick the group
+static inline std::uint8_t ctrlOf(const size_t &hash) { return hash & 0x7F; }
+static inline size_t groupOf(const size_t &hash) { return hash >> 7; }
+
+// spreads ints (and pointers) over all the bits of the hash
+static inline size_t mix(std::uint64_t x) {
+  x ^= x >> 30;
+  x *= 0xBF58476D1CE4E5B9ULL;
+  x ^= x >> 27;
+  x *= 0x94D049BB133111EBULL;
+  x ^= x >> 31;
+  return x;
+}
+
+static size_t keyHash(const Value &key) {
+  if (key.isInt())
+    return mix(key.asInt());
+  if (!key.isVar())
+    return mix(key.bits());
+  VarBase *var = key.asVar();
+  if (var->isa<VarString>())
+    return AsString(var)->hash();
+  if (var->isa<VarInt>())
+    return mix(AsInt(var)->get());
+  return mix(reinterpret_cast<std::uintptr_t>(var));
+}
+
+static bool keyEquals(const Value &lhs, const Value &rhs) {
+  if (lhs == rhs)
+    return true;
+  if (lhs.isFloat() && rhs.isFloat())
+    return lhs.asFloat() == rhs.asFloat();
+  if (!lhs.isVar() || !rhs.isVar())
+    return false;
+  VarBase *l = lhs.asVar(), *r = rhs.asVar();
+  if (l->isa<VarString>() && r->isa<VarString>())
+    return AsString(l)->equals(AsString(r));
+  if (l->isa<VarInt>() && r->isa<VarInt>())
+    return AsInt(l)->get() == AsInt(r)->get();
+  return false;
+}
+
+// heap ints, floats, bools and nil are keyed by their inline form
+static inline Value keyOf(const Value &key) {
+  Value res = key.isVar() ? unbox(key.asVar()) : key;
+  // -0.0 and 0.0 are the same key
+  if (res.isFloat() && res.asFloat() == 0)
+    return Value::fromFloat(0);
+  return res;
+}
+
+// The slot holding `key`, or the number of slots if there is none. The index
+// is never full, so every probe ends at an empty slot.
+static size_t findSlot(const MapData &data, const Value &key,
+                       const size_t &hash) {
+  size_t groups = data.ctrl.size() / kMapGroup;
+  if (groups == 0)
+    return 0;
+  std::uint8_t c = ctrlOf(hash);
+  size_t g = groupOf(hash) & (groups - 1);
+  for (size_t step = 1;; ++step) {
+    const std::uint8_t *ctrl = data.ctrl.data() + g * kMapGroup;
+    for (unsigned m = matchCtrl(ctrl, c); m; m &= m - 1) {
+      size_t slot = g * kMapGroup + __builtin_ctz(m);
+      const MapEntry &e = data.entries[data.slots[slot]];
+      if (e.hash == hash && keyEquals(e.key, key))
+        return slot;
+    }
+    if (matchCtrl(ctrl, kCtrlEmpty))
+      return data.ctrl.size();
+    // triangular steps visit every group once the count is a power of 2
+    g = (g + step) & (groups - 1);
+  }
+}
+
+// the first empty or removed slot on the way to where `hash` would be
+static size_t freeSlot(const MapData &data, const size_t &hash) {
+  size_t groups = data.ctrl.size() / kMapGroup;
+  size_t g = groupOf(hash) & (groups - 1);
+  for (size_t step = 1;; ++step) {
+    const std::uint8_t *ctrl = data.ctrl.data() + g * kMapGroup;
+    unsigned m = matchCtrl(ctrl, kCtrlEmpty) | matchCtrl(ctrl, kCtrlRemoved);
+    if (m)
+      return g * kMapGroup + __builtin_ctz(m);
+    g = (g + step) & (groups - 1);
+  }
+}
+
+// Drops removed entries and rebuilds the index with room for `count` of
+// them, keeping at most 7/8 of the slots in use.
+static void rehash(MapData &data, const size_t &count) {
+  size_t removed = 0;
+  for (size_t i = 0; i < data.entries.size(); ++i) {
+    if (data.entries[i].key.isUndef())
+      ++removed;
+    else if (removed > 0)
+      data.entries[i - removed] = data.entries[i];
+  }
+  data.entries.resize(data.entries.size() - removed);
+
+  size_t cap = kMapGroup;
+  while (cap * 7 / 8 < count)
+    cap *= 2;
+  data.ctrl.assign(cap, kCtrlEmpty);
+  data.slots.assign(cap, 0);
+  for (size_t i = 0; i < data.entries.size(); ++i) {
+    size_t slot = freeSlot(data, data.entries[i].hash);
+    data.ctrl[slot] = ctrlOf(data.entries[i].hash);
+    data.slots[slot] = i;
+  }
+}
+
+VarMap::VarMap(const size_t &srcId, const size_t &idx)
+    : VarBase(type_id<VarMap>(), srcId, idx, false, false),
+      _data(new VarBuf<MapData>(MapData())) {}
+
+VarMap::VarMap(VarBuf<MapData> *data, const size_t &srcId, const size_t &idx)
+    : VarBase(type_id<VarMap>(), srcId, idx, false, false), _data(data) {}
+
+VarMap::~VarMap() { release(); }
+
+void VarMap::release() {
+  if (!_data->dref())
+    return;
+  for (auto &e : _data->data.entries) {
+    valDref(e.key);
+    valDref(e.val);
+  }
+  delete _data;
+}
+
+VarBase *VarMap::copy(const size_t &srcId, const size_t &idx) {
+  _data->iref();
+  return new VarMap(_data, srcId, idx);
+}
+
+MapData &VarMap::mutData() {
+  if (_data->unique())
+    return _data->data;
+  // keys are never written to so they can be shared, values are copied like
+  // the elements of a vector
+  MapData own = _data->data;
+  for (auto &e : own.entries) {
+    if (e.key.isUndef())
+      continue;
+    valIref(e.key);
+    if (e.val.isVar())
+      e.val = Value::fromVar(e.val.asVar()->copy(srcId(), idx()));
+  }
+  release();
+  _data = new VarBuf<MapData>(std::move(own));
+  return _data->data;
+}
+
+Value VarMap::get(const Value &key) const {
+  const MapData &data = _data->data;
+  Value k = keyOf(key);
+  size_t slot = findSlot(data, k, keyHash(k));
+  if (slot == data.ctrl.size())
+    return Value();
+  return data.entries[data.slots[slot]].val;
+}
+
+void VarMap::put(const Value &key, const Value &val) {
+  Value k = keyOf(key);
+  size_t hash = keyHash(k);
+  MapData &data = mutData();
+  size_t slot = findSlot(data, k, hash);
+  // a var someone else holds is stored as a copy, so a later `OpStore` to it
+  // can't change the value in the map, the same as `OpCreate`
+  Value v = val;
+  if (v.isVar() && !v.asVar()->isLoadAsRef() && v.asVar()->refCount() > 1) {
+    v = Value::fromVar(v.asVar()->copy(srcId(), idx()));
+  } else {
+    if (v.isVar())
+      v.asVar()->unsetLoadAsRef();
+    valIref(v);
+  }
+  if (slot != data.ctrl.size()) {
+    Value &old = data.entries[data.slots[slot]].val;
+    valDref(old);
+    old = v;
+    return;
+  }
+
+  if (k.isVar() && k.asVar()->isa<VarString>())
+    k = Value::fromVar(k.asVar()->copy(srcId(), idx()));
+  else
+    valIref(k);
+  if ((data.entries.size() + 1) > data.ctrl.size() * 7 / 8)
+    rehash(data, data.count + 1);
+  slot = freeSlot(data, hash);
+  data.ctrl[slot] = ctrlOf(hash);
+  data.slots[slot] = data.entries.size();
+  data.entries.push_back({k, v, hash});
+  ++data.count;
+}
+
+bool VarMap::remove(const Value &key) {
+  Value k = keyOf(key);
+  size_t hash = keyHash(k);
+  if (findSlot(_data->data, k, hash) == _data->data.ctrl.size())
+    return false;
+  MapData &data = mutData();
+  size_t slot = findSlot(data, k, hash);
+  MapEntry &e = data.entries[data.slots[slot]];
+  valDref(e.key);
+  valDref(e.val);
+  e.key = Value();
+  e.val = Value();
+  data.ctrl[slot] = kCtrlRemoved;
+  --data.count;
+  // the entry itself is dropped by the next rehash, do one early if most of
+  // the entries are gone so iterating stays cheap
+  if (data.count < data.entries.size() / 2)
+    rehash(data, data.count);
+  return true;
+}
+
+void VarMap::set(VarBase *from) {
+  if (from->isa<VarMap>()) {
+    VarBuf<MapData> *other = AsMap(from)->_data;
+    other->iref();
+    release();
+    _data = other;
+  } else {
+    release();
+    _data = new VarBuf<MapData>(MapData());
+  }
+}
+
+void VarMap::share() {
+  VarBase::share();
+  for (auto &e : _data->data.entries) {
+    if (e.key.isVar())
+      e.key.asVar()->share();
+    if (e.val.isVar())
+      e.val.asVar()->share();
+  }
+}
+
+static const Symbol sizeSym = symbols::intern("size");
+
+Value VarMap::attrGet(const Symbol &attr) {
+  if (attr == sizeSym)
+    return Value::fromInt((long long)size());
+  return Value();
+}
+
+void VarMap::attrSet(const Symbol &attr, Value val, const bool iref) {
+  // currently no attributes
+}
+
+bool VarMap::attrExists(const Symbol &attr) const { return attr == sizeSym; }
+
+} // namespace june
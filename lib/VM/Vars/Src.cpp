@@ -35,31 +35,40 @@ void VarSrc::set(VarBase *from) {
   }
 }
 
-bool VarSrc::attrExists(const std::string &name) const {
+bool VarSrc::attrExists(const Symbol &name) const {
   return _vars->exists(name);
 }
 
-void VarSrc::attrSet(const std::string &name, VarBase *val, const bool iref) {
+void VarSrc::attrSet(const Symbol &name, Value val, const bool iref) {
   _vars->add(name, val, iref);
 }
 
-VarBase *VarSrc::attrGet(const std::string &name) { return _vars->get(name); }
+Value VarSrc::attrGet(const Symbol &name) { return _vars->get(name); }
 
 void VarSrc::addNativeFn(const std::string &name, NativeFnPtr fn,
                          const size_t &argsCount, const bool &isVarArgs) {
-  _vars->add(name,
-             new VarFunc(_src->path(), isVarArgs ? "." : "",
-                       std::vector<std::string>(argsCount, ""), {.native = fn},
-                       true, _src->id(), 0),
+  _vars->add(symbols::intern(name),
+             Value::fromVar(new VarFunc(
+                 _src->path(), isVarArgs ? "." : "",
+                 std::vector<std::string>(argsCount, ""), {.native = fn}, true,
+                 _src->id(), 0)),
+             false);
+}
+
+void VarSrc::addNativeFn(const std::string &name, NativeFixedFnPtr fn,
+                         const size_t &argsCount) {
+  _vars->add(symbols::intern(name),
+             Value::fromVar(
+                 new VarFunc(_src->path(), argsCount, fn, _src->id(), 0)),
              false);
 }
 
 void VarSrc::addNativeVar(const std::string &name, VarBase *val,
                           const bool iref, const bool moduleLevel) {
   if (moduleLevel)
-    _vars->addm(name, val, iref);
+    _vars->addm(symbols::intern(name), Value::fromVar(val), iref);
   else
-    _vars->add(name, val, iref);
+    _vars->add(symbols::intern(name), Value::fromVar(val), iref);
 }
 
 SrcFile *VarSrc::src() { return _src; }
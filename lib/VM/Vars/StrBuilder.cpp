@@ -0,0 +1,26 @@
+#include "VM/Vars/Base.hpp"
+
+namespace june {
+
+VarStrBuilder::VarStrBuilder(const std::string &val, const size_t &srcId,
+                             const size_t &idx)
+    : VarBase(type_id<VarStrBuilder>(), srcId, idx, false, false),
+      _data(val) {}
+
+VarBase *VarStrBuilder::copy(const size_t &srcId, const size_t &idx) {
+  return new VarStrBuilder(_data, srcId, idx);
+}
+
+std::string &VarStrBuilder::get() { return _data; }
+
+void VarStrBuilder::set(VarBase *from) {
+  if (from->isa<VarStrBuilder>()) {
+    _data = AsStrBuilder(from)->get();
+  } else if (from->isa<VarString>()) {
+    _data = AsString(from)->get();
+  } else {
+    _data.clear();
+  }
+}
+
+} // namespace june
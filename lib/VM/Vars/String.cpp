@@ -1,25 +1,245 @@
 #include "VM/Vars/Base.hpp"
 
+#include <functional>
+#include <mutex>
+#include <unordered_map>
+#include <vector>
+
 namespace june {
 
+// Shared by every thread and never shrinks, only string constants are interned
+// and they're only added when code is loaded.
+class StrTable {
+  std::mutex lock;
+  std::unordered_map<std::string, StrBuf *> bufs;
+
+public:
+  static StrTable &instance() {
+    // never destroyed, strings may outlive static destruction
+    static StrTable *table = new StrTable();
+    return *table;
+  }
+
+  StrBuf *intern(const std::string &data) {
+    std::lock_guard<std::mutex> guard(lock);
+    auto it = bufs.find(data);
+    if (it != bufs.end()) {
+      it->second->iref();
+      return it->second;
+    }
+    // the table keeps the first reference, so the buffer is never freed
+    StrBuf *buf = new StrBuf(data, true);
+    bufs.emplace(data, buf);
+    buf->iref();
+    return buf;
+  }
+};
+
+StrBuf *StrBuf::intern(const std::string &data) {
+  return StrTable::instance().intern(data);
+}
+
+void StrRope::release(StrRope *node) {
+  // iteratively, ropes built in a loop are about as deep as they're long
+  std::vector<StrRope *> todo{node};
+  while (!todo.empty()) {
+    StrRope *n = todo.back();
+    todo.pop_back();
+    if (n->refs.fetch_sub(1, std::memory_order_acq_rel) != 1)
+      continue;
+    if (n->text) {
+      if (n->text->dref())
+        delete n->text;
+    } else {
+      todo.push_back(n->left);
+      todo.push_back(n->right);
+    }
+    delete n;
+  }
+}
+
+// never 0, which marks a hash that isn't computed yet
+static inline size_t hashOf(const std::string &data) {
+  size_t h = std::hash<std::string>()(data);
+  return h == 0 ? 1 : h;
+}
+
 VarString::VarString(const std::string &val, const size_t &srcId,
                      const size_t &idx)
-    : VarBase(type_id<VarString>(), srcId, idx, false, false), _data(val) {}
+    : VarBase(type_id<VarString>(), srcId, idx, false, false), _own(val),
+      _buf(nullptr), _rope(nullptr) {}
+
+VarString::VarString(StrBuf *buf, const size_t &srcId, const size_t &idx)
+    : VarBase(type_id<VarString>(), srcId, idx, false, false), _buf(buf),
+      _rope(nullptr) {}
+
+VarString::VarString(StrRope *rope, const size_t &srcId, const size_t &idx)
+    : VarBase(type_id<VarString>(), srcId, idx, false, false), _buf(nullptr),
+      _rope(rope) {}
+
+VarString::~VarString() { release(); }
+
+void VarString::release() const {
+  if (_buf && _buf->dref())
+    delete _buf;
+  _buf = nullptr;
+  if (_rope)
+    StrRope::release(_rope);
+  _rope = nullptr;
+}
+
+void VarString::flatten() const {
+  std::string text;
+  text.reserve(_rope->size);
+  std::vector<const StrRope *> todo{_rope};
+  while (!todo.empty()) {
+    const StrRope *node = todo.back();
+    todo.pop_back();
+    if (node->text) {
+      text += node->text->data;
+      continue;
+    }
+    todo.push_back(node->right);
+    todo.push_back(node->left);
+  }
+  release();
+  _own = std::move(text);
+}
+
+StrRope *VarString::asRope() {
+  if (_rope) {
+    _rope->iref();
+    return _rope;
+  }
+  StrBuf *buf = _buf;
+  if (!buf && _own.size() > kInlineStrSize) {
+    // shared by both from now on, as by `copy()`
+    _buf = buf = new StrBuf(std::move(_own), false);
+    _own.clear();
+  }
+  if (buf)
+    buf->iref();
+  else
+    buf = new StrBuf(_own, false);
+  return new StrRope(buf->data.size(), buf, nullptr, nullptr);
+}
+
+size_t VarString::size() const { return _rope ? _rope->size : get().size(); }
+
+VarString *VarString::concat(VarString *lhs, VarString *rhs,
+                             const size_t &srcId, const size_t &idx) {
+  size_t size = lhs->size() + rhs->size();
+  if (size <= kMinRopeSize)
+    return new VarString(lhs->get() + rhs->get(), srcId, idx);
+  StrRope *node = new StrRope(size, nullptr, lhs->asRope(), rhs->asRope());
+  return new VarString(node, srcId, idx);
+}
+
+void VarString::share() {
+  if (_rope)
+    flatten();
+  VarBase::share();
+}
 
 VarBase *VarString::copy(const size_t &srcId, const size_t &idx) {
-  return new VarString(_data, srcId, idx);
+  if (_rope) {
+    _rope->iref();
+    return new VarString(_rope, srcId, idx);
+  }
+  if (!_buf) {
+    if (_own.size() <= kInlineStrSize)
+      return new VarString(_own, srcId, idx);
+    // shared by both from now on
+    _buf = new StrBuf(std::move(_own), false);
+    _own.clear();
+  }
+  _buf->iref();
+  return new VarString(_buf, srcId, idx);
+}
+
+std::string &VarString::getMut() {
+  if (_rope)
+    flatten();
+  if (_buf) {
+    // buffers are never written to, take the text out of it instead
+    if (!_buf->interned && _buf->unique())
+      _own = std::move(_buf->data);
+    else
+      _own = _buf->data;
+    release();
+  }
+  return _own;
+}
+
+size_t VarString::hash() {
+  if (!_buf)
+    return hashOf(get());
+  size_t h = _buf->hash.load(std::memory_order_relaxed);
+  if (h == 0) {
+    h = hashOf(_buf->data);
+    _buf->hash.store(h, std::memory_order_relaxed);
+  }
+  return h;
+}
+
+bool VarString::equals(VarString *other) {
+  if (_buf && _buf == other->_buf)
+    return true;
+  // two interned buffers may still hold the same text (a module carrying its
+  // own copy of the VM interns into its own table), but their hashes are
+  // worth caching since constants are compared over and over
+  if (_buf && other->_buf && _buf->interned && other->_buf->interned &&
+      hash() != other->hash())
+    return false;
+  const std::string &lhs = get(), &rhs = other->get();
+  if (lhs.size() != rhs.size())
+    return false;
+  // only compare hashes someone already paid for
+  if (_buf && other->_buf) {
+    size_t lh = _buf->hash.load(std::memory_order_relaxed);
+    size_t rh = other->_buf->hash.load(std::memory_order_relaxed);
+    if (lh != 0 && rh != 0 && lh != rh)
+      return false;
+  }
+  return lhs == rhs;
+}
+
+Symbol VarString::symbol() {
+  if (!_buf || !_buf->interned)
+    return symbols::intern(get());
+  // interned text never changes, so is interned as a name only once, see
+  // `constants::pool()`
+  Symbol sym = _buf->sym.load(std::memory_order_relaxed);
+  if (sym == symbols::kNone) {
+    sym = symbols::intern(_buf->data);
+    _buf->sym.store(sym, std::memory_order_relaxed);
+  }
+  return sym;
 }
-std::string &VarString::get() { return _data; }
 
 void VarString::set(VarBase *from) {
   if (from->isa<VarString>()) {
-    _data = AsString(from)->get();
+    VarString *other = AsString(from);
+    if (other == this)
+      return;
+    if (other->_rope) {
+      other->_rope->iref();
+      release();
+      _rope = other->_rope;
+    } else if (other->_buf) {
+      other->_buf->iref();
+      release();
+      _buf = other->_buf;
+    } else {
+      release();
+      _own = other->_own;
+    }
   } else if (from->isa<VarInt>()) {
-    _data = std::to_string(AsInt(from)->get());
+    getMut() = std::to_string(AsInt(from)->get());
   } else if (from->isa<VarBool>()) {
-    _data = std::to_string(AsBool(from)->get());
+    getMut() = std::to_string(AsBool(from)->get());
   } else {
-    _data = "";
+    getMut().clear();
   }
 }
 
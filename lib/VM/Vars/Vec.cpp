@@ -4,59 +4,220 @@
 
 namespace june {
 
+void VecData::pushBool(const bool &val) {
+  if (bools % 64 == 0)
+    bits.push_back(0);
+  if (val)
+    bits.back() |= 1ULL << (bools % 64);
+  ++bools;
+}
+
 VarVec::VarVec(const std::vector<VarBase *> &val, const bool &refs,
                const size_t &srcId, const size_t &idx)
-    : VarBase(type_id<VarVec>(), srcId, idx, refs, false), _data(val),
+    : VarBase(type_id<VarVec>(), srcId, idx, refs, false),
+      _data(new VarBuf<VecData>(VecData(val))), _refs(refs) {}
+
+VarVec::VarVec(VecData data, const size_t &srcId, const size_t &idx)
+    : VarBase(type_id<VarVec>(), srcId, idx, false, false),
+      _data(new VarBuf<VecData>(std::move(data))), _refs(false) {}
+
+VarVec::VarVec(VarBuf<VecData> *data, const bool &refs, const size_t &srcId,
+               const size_t &idx)
+    : VarBase(type_id<VarVec>(), srcId, idx, refs, false), _data(data),
       _refs(refs) {}
 
-VarVec::~VarVec() {
-  for (auto &v : _data)
+VarVec::~VarVec() { release(); }
+
+void VarVec::release() {
+  if (!_data->dref())
+    return;
+  for (auto &v : _data->data.vars)
     varDref(v);
+  delete _data;
 }
 
 VarBase *VarVec::copy(const size_t &srcId, const size_t &idx) {
-  std::vector<VarBase *> newVec;
-  if (_refs) {
-    for (auto &v : _data) {
+  _data->iref();
+  return new VarVec(_data, _refs, srcId, idx);
+}
+
+VecData &VarVec::mutData() {
+  if (_data->unique())
+    return _data->data;
+  const VecData &old = _data->data;
+  VecData own(old.kind);
+  if (old.kind != VkVars) {
+    own = old;
+  } else if (_refs) {
+    own.vars.reserve(old.vars.size());
+    for (auto &v : old.vars) {
       varIref(v);
-      newVec.push_back(v);
+      own.vars.push_back(v);
     }
   } else {
-    for (auto &v : _data)
-      newVec.push_back(v->copy(srcId, idx));
+    own.vars.reserve(old.vars.size());
+    for (auto &v : old.vars)
+      own.vars.push_back(v->copy(srcId(), idx()));
   }
-  return new VarVec(newVec, _refs, srcId, idx);
+  release();
+  _data = new VarBuf<VecData>(std::move(own));
+  return _data->data;
 }
 
-std::vector<VarBase *> &VarVec::get() { return _data; }
+void VarVec::toVars() {
+  if (kind() == VkVars)
+    return;
+  VecData &data = mutData();
+  size_t count = size();
+  data.vars.reserve(count);
+  for (size_t i = 0; i < count; ++i) {
+    switch (data.kind) {
+    case VkInt:
+      data.vars.push_back(new VarInt(data.ints[i], srcId(), idx()));
+      break;
+    case VkFloat:
+      data.vars.push_back(new VarFloat(data.floats[i], srcId(), idx()));
+      break;
+    default:
+      data.vars.push_back(new VarBool(data.boolAt(i), srcId(), idx()));
+      break;
+    }
+  }
+  data.kind = VkVars;
+  data.ints = {};
+  data.floats = {};
+  data.bits = {};
+  data.bools = 0;
+}
+
+size_t VarVec::size() const {
+  const VecData &data = _data->data;
+  switch (data.kind) {
+  case VkInt:
+    return data.ints.size();
+  case VkFloat:
+    return data.floats.size();
+  case VkBool:
+    return data.bools;
+  default:
+    return data.vars.size();
+  }
+}
+
+Value VarVec::at(const size_t &i) const {
+  const VecData &data = _data->data;
+  switch (data.kind) {
+  case VkInt:
+    return Value::fromInt(data.ints[i]);
+  case VkFloat:
+    return Value::fromFloat(data.floats[i]);
+  case VkBool:
+    return Value::fromBool(data.boolAt(i));
+  default:
+    return Value::fromVar(data.vars[i]);
+  }
+}
+
+// the kind a vector holding only `val` would have
+static VecKind kindOf(const Value &val) {
+  if (val.isInt())
+    return VkInt;
+  if (val.isFloat())
+    return VkFloat;
+  if (val.isBool())
+    return VkBool;
+  return VkVars;
+}
+
+void VarVec::push(const Value &val) {
+  VecKind want = _refs ? VkVars : kindOf(val);
+  if (size() == 0 && kind() != want) {
+    VecData &data = mutData();
+    data.kind = want;
+  } else if (want != kind()) {
+    toVars();
+  }
+  VecData &data = mutData();
+  switch (data.kind) {
+  case VkInt:
+    data.ints.push_back(val.asInt());
+    break;
+  case VkFloat:
+    data.floats.push_back(val.asFloat());
+    break;
+  case VkBool:
+    data.pushBool(val.asBool());
+    break;
+  default: {
+    VarBase *var = val.isVar() ? val.asVar() : nullptr;
+    if (val.isInt())
+      var = new VarInt(val.asInt(), srcId(), idx());
+    else if (val.isFloat())
+      var = new VarFloat(val.asFloat(), srcId(), idx());
+    else if (val.isBool())
+      var = new VarBool(val.asBool(), srcId(), idx());
+    else if (!var)
+      var = new VarNil(srcId(), idx());
+    else if (_refs || var->isLoadAsRef() || var->refCount() == 1) {
+      // a temporary, or asked to be stored by reference
+      var->unsetLoadAsRef();
+      varIref(var);
+    } else {
+      // a var someone else holds, a later `OpStore` to it must not change
+      // the element, the same as `OpCreate`
+      var = var->copy(srcId(), idx());
+    }
+    data.vars.push_back(var);
+    break;
+  }
+  }
+}
+
+const std::vector<VarBase *> &VarVec::get() {
+  toVars();
+  return _data->data.vars;
+}
+
+std::vector<VarBase *> &VarVec::getMut() {
+  toVars();
+  return mutData().vars;
+}
 
 bool VarVec::isRefVec() { return _refs; }
 void VarVec::set(VarBase *from) {
   if (from->isa<VarVec>()) {
-    _data.clear();
-    for (auto &v : AsVec(from)->get()) {
-      varIref(v);
-      _data.push_back(v);
-    }
+    VarBuf<VecData> *other = AsVec(from)->_data;
+    other->iref();
+    release();
+    _data = other;
     _refs = AsVec(from)->isRefVec();
   } else {
-    _data.clear();
+    release();
+    _data = new VarBuf<VecData>(VecData());
   }
 }
 
-VarBase *VarVec::attrGet(const std::string &attr) {
-  if (attr == "size")
-    return make_all<VarInt>((long long)_data.size(), this->srcId(), this->idx());
-  return nullptr;
+void VarVec::share() {
+  VarBase::share();
+  for (auto &v : _data->data.vars)
+    v->share();
+}
+
+static const Symbol sizeSym = symbols::intern("size");
+
+Value VarVec::attrGet(const Symbol &attr) {
+  if (attr == sizeSym)
+    return Value::fromInt((long long)size());
+  return Value();
 }
 
-void VarVec::attrSet(const std::string &attr, VarBase *val, const bool iref) {
+void VarVec::attrSet(const Symbol &attr, Value val, const bool iref) {
   // currently no attributes
   // todo: implement attributes
 }
 
-bool VarVec::attrExists(const std::string &attr) const {
-  return attr == "size";
+bool VarVec::attrExists(const Symbol &attr) const {
+  return attr == sizeSym;
 }
 
 }
@@ -1,6 +1,7 @@
 #include "Common.hpp"
 #include "JuneConfig.hpp"
 #include "VM/State.hpp"
+#include "VM/Trace.hpp"
 #include <cctype>
 #include <iostream>
 #include <vector>
@@ -16,7 +17,7 @@ err::Errors JuneReadCode(const SrcFile *src, const std::string &srcDir,
                          const size_t &beginIdx, const size_t &endIdx) {
   bc.adds(0, OpLoad, OdtIdent, "print");
   bc.adds(1, OpLoad, OdtString, "Hello, World!");
-  bc.adds(2, OpCall, OdtString, "00");
+  bc.addsz(2, OpCall, arity::encode(1, false));
   bc.add(3, OpUnload);
 
   // if it's a bytecode file, it'll already be loaded
@@ -47,9 +48,7 @@ SrcFile *JuneLoadCode(const std::string &srcFile, const std::string &srcDir,
     return nullptr;
   }
 
-  for (auto &bc : src->bytecode().getMut()) {
-    bc.srcId = src->id();
-  }
+  src->bytecode().setSrcId(src->id());
 
   return src;
 }
@@ -57,6 +56,21 @@ SrcFile *JuneLoadCode(const std::string &srcFile, const std::string &srcDir,
 int main(int argc, char **argv) {
   ArgsAddArgument("help", "-h", "--help", "Print this help message");
   ArgsAddArgument("version", "-v", "--version", "Print the version");
+  ArgsAddArgument("no-opt", "", "--no-opt",
+                  "Turn off the given optimizer passes (comma separated, or "
+                  "'all')",
+                  true, true);
+  ArgsAddArgument("opt-stats", "", "--opt-stats",
+                  "Print what the optimizer passes did on exit");
+#if JuneTrace == true
+  ArgsAddArgument("trace", "", "--trace",
+                  "Trace what the vm does (comma separated: ops, mem or "
+                  "'all')",
+                  true, true);
+  ArgsAddArgument("trace-file", "", "--trace-file",
+                  "Write trace records to the given file instead of stderr",
+                  true, true);
+#endif
   ArgsParseArguments(argc, argv);
 
   if (!ArgsAnyArgumentExists()) {
@@ -73,9 +87,29 @@ int main(int argc, char **argv) {
     return 0;
   }
 
+#if JuneTrace == true
+  if (ArgsArgumentExists("trace")) {
+    std::string kinds = ArgsGetArgument("trace").value;
+    std::string path;
+    if (ArgsArgumentExists("trace-file"))
+      path = ArgsGetArgument("trace-file").value;
+    if (!trace::enable(kinds, path)) {
+      std::cerr << "Cannot trace: " << kinds << std::endl;
+      return 1;
+    }
+  }
+#endif
+
   std::string juneBase, juneBin;
   juneBin = fs::absPath(env::getProcPath(), &juneBase, true);
   State vm(juneBin, juneBase, ArgsGetCodeArgs());
+  if (ArgsArgumentExists("no-opt")) {
+    std::string passes = ArgsGetArgument("no-opt").value;
+    if (!vm.pipeline.disable(passes)) {
+      std::cerr << "Unknown optimizer pass in: " << passes << std::endl;
+      return 1;
+    }
+  }
 
   auto mainFileArg = ArgsGetPositional(0);
   if (!fs::exists(mainFileArg.value).unwrap()) {
@@ -106,6 +140,8 @@ int main(int argc, char **argv) {
 
   auto execErr = vm::exec(vm);
   vm.popSrc();
+  if (ArgsArgumentExists("opt-stats"))
+    vm.pipeline.dumpStats(std::cerr);
   if (execErr.isErr()) {
     execErr.getErr()->print(std::cerr);
     std::cerr << "Failed to execute main file" << std::endl;
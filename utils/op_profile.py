@@ -0,0 +1,115 @@
+#!/usr/bin/env python3
+
+import sys
+from collections import Counter
+
+USAGE = """usage: op_profile.py trace...
+
+Counts which instructions run right after each other in `--trace ops` output,
+to check which sequences are worth a superinstruction (`fuseSequences()` in
+lib/VM/Passes.cpp). Traces should be taken with the fuse pass turned off so
+the sequences show up unfused:
+
+  june --no-opt fuse --trace ops --trace-file prog.trace prog.june
+"""
+
+# the superinstructions the pass makes
+KINDS = ['CallUnload', 'CmpJumpFalse', 'LoadJumpFalse', 'LoadLoadCall']
+
+COMPARISONS = {'Lt', 'Le', 'Gt', 'Ge', 'Eq', 'Ne'}
+
+
+def key(op, dtype):
+  # loads are told apart by what they load, as the pass does
+  return op + ':' + dtype if op == 'Load' else op
+
+
+def is_name_load(k):
+  return k in ('LoadSlot', 'Load:Symbol')
+
+
+def kind_of(seq):
+  """The superinstruction `seq` (a pair or triple of keys) would become."""
+  if len(seq) == 2:
+    if seq[0] in ('Call', 'MemberCall') and seq[1] == 'Unload':
+      return 'CallUnload'
+    if seq[0] in COMPARISONS and seq[1] == 'JumpFalsePop':
+      return 'CmpJumpFalse'
+    if is_name_load(seq[0]) and seq[1] == 'JumpFalsePop':
+      return 'LoadJumpFalse'
+  elif (is_name_load(seq[0]) and
+        (is_name_load(seq[1]) or seq[1] == 'Load:Const') and seq[2] == 'Call'):
+    return 'LoadLoadCall'
+  return None
+
+
+def count(paths):
+  total = 0
+  pairs = Counter()
+  triples = Counter()
+  # per exec depth: (src, index, keys of the instructions run right before)
+  frames = {}
+  for path in paths:
+    with open(path) as f:
+      for line in f:
+        fields = line.rstrip('\n').split('\t')
+        if len(fields) != 7 or fields[0] != 'ops':
+          continue
+        _, src, depth, idx, op, dtype, _ = fields
+        depth, idx, k = int(depth), int(idx), key(op, dtype)
+        total += 1
+        # anything deeper has returned
+        for d in [d for d in frames if d > depth]:
+          del frames[d]
+        prev = frames.get(depth)
+        run = [k]
+        # only instructions falling through to the next one in the same frame
+        if prev and prev[0] == src and prev[1] + 1 == idx:
+          run = prev[2][-2:] + [k]
+          pairs[tuple(run[-2:])] += 1
+          if len(run) == 3:
+            triples[tuple(run)] += 1
+        frames[depth] = (src, idx, run)
+  return total, pairs, triples
+
+
+def report(total, pairs, triples, out):
+  per_mille = lambda n: n * 1000.0 / total if total else 0
+  out.write('instructions executed: %d\n' % total)
+  for name, seqs in (('pairs', pairs), ('triples', triples)):
+    out.write('\ntop %s (count, per 1000 instructions):\n' % name)
+    for seq, n in seqs.most_common(25):
+      out.write('  %-40s %10d %7.1f\n' % (' '.join(seq), n, per_mille(n)))
+
+
+def saved(pairs, triples):
+  """Dispatches each superinstruction would save."""
+  res = Counter()
+  for seqs, skipped in ((pairs, 1), (triples, 2)):
+    for seq, n in seqs.items():
+      kind = kind_of(seq)
+      if kind:
+        res[kind] += n * skipped
+  return res
+
+
+def main():
+  traces = sys.argv[1:]
+  if not traces:
+    sys.stderr.write(USAGE)
+    sys.exit(1)
+
+  total, pairs, triples = count(traces)
+  if total == 0:
+    sys.stderr.write('no ops records found\n')
+    sys.exit(1)
+  res = saved(pairs, triples)
+
+  report(total, pairs, triples, sys.stdout)
+  print('\ndispatches saved per 1000 instructions:')
+  for kind in KINDS:
+    print('  %-20s %7.1f' % (kind, res[kind] * 1000.0 / total))
+
+
+if __name__ == '__main__':
+  main()